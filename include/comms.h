@@ -2,6 +2,7 @@
 
 #include "model.h"
 #include "sound.h"
+#include "undo.h"
 
 #define MESSAGE_QUEUE_CAPACITY 0x100
 
@@ -19,6 +20,11 @@ typedef struct SoundMessage {
   Sound sound;
 } SoundMessage;
 
+typedef struct RestoreMessage {
+  UndoStep step;
+  Bool forward;                           // redo, writing what the edit wrote
+} RestoreMessage;
+
 typedef struct ResizeMessage {
   ProgramHistory primary;
   ProgramHistory secondary;
@@ -33,17 +39,22 @@ typedef enum ControlMessageTag {
   CONTROL_MESSAGE_MEMORY_RESIZE,
   CONTROL_MESSAGE_CLEAR,
   CONTROL_MESSAGE_PAUSE,
+  CONTROL_MESSAGE_RESTORE,
+  CONTROL_MESSAGE_CAPACITY,
   CONTROL_MESSAGE_CARDINAL,
 } ControlMessageTag;
 
 typedef struct ControlMessage {
   ControlMessageTag tag;
+  UndoStep undo;                          // for a write, power or clear, see undo.h
   union {
     WriteMessage write;
     PowerMessage power;
     SoundMessage sound;
     ResizeMessage resize;
+    RestoreMessage restore;
     S32 tempo;
+    Index operators;                      // see CONTROL_MESSAGE_CAPACITY
   };
 } ControlMessage;
 
@@ -53,6 +64,8 @@ ControlMessage control_message_power(V2S point);
 ControlMessage control_message_sound(S32 slot, Sound sound);
 ControlMessage control_message_tempo(S32 tempo);
 ControlMessage control_message_memory_resize(ProgramHistory primary, ProgramHistory secondary);
+ControlMessage control_message_restore(UndoStep step, Bool forward);
+ControlMessage control_message_capacity(Index operators);
 
 #define ATOMIC_QUEUE_ELEMENT Index
 #define ATOMIC_QUEUE_INTERFACE
@@ -68,5 +81,23 @@ extern ATOMIC_QUEUE_TYPE(Index) allocation_queue;
 // FIFO of allocation messages from audio thread to render thread
 extern ATOMIC_QUEUE_TYPE(Index) free_queue;
 
+// FIFO of finished profile windows from audio thread to render thread
+extern ATOMIC_QUEUE_TYPE(Index) profile_queue;
+
+// FIFO of released profile windows from render thread to audio thread
+extern ATOMIC_QUEUE_TYPE(Index) profile_free_queue;
+
+// FIFO of dsp states from audio thread to render thread, one per period,
+// since the history slots are only published when memory changes
+extern ATOMIC_QUEUE_TYPE(Index) dsp_queue;
+
+// FIFO of released dsp states from render thread to audio thread
+extern ATOMIC_QUEUE_TYPE(Index) dsp_free_queue;
+
 // FIFO of control messages from render thread to audio thread
 extern ATOMIC_QUEUE_TYPE(ControlMessage) control_queue;
+
+// FIFO of messages from audio thread to render thread. A resize carries the
+// histories it replaced, which the render thread can then free. A capacity
+// message asks for a history with room for as many operators.
+extern ATOMIC_QUEUE_TYPE(ControlMessage) retire_queue;
@@ -5,3 +5,6 @@
 #pragma once
 
 #define Config_AUDIO_SAMPLE_RATE 48000
+
+// time each operator in the evaluation profile, not just count it
+#define Config_PROFILE_TIMING 0
@@ -37,6 +37,7 @@ typedef enum Interaction {
   INTERACTION_FILE_DIALOG,
   INTERACTION_MEMORY_DIMENSIONS,
   INTERACTION_TEMPO,
+  INTERACTION_SCRUB,
   INTERACTION_CARDINAL,
 } Interaction;
 
@@ -61,6 +62,8 @@ typedef enum EditMenuItem {
   EDIT_MENU_CUT,
   EDIT_MENU_COPY,
   EDIT_MENU_PASTE,
+  EDIT_MENU_UNDO,
+  EDIT_MENU_REDO,
   EDIT_MENU_CARDINAL,
 } EditMenuItem;
 
@@ -87,6 +90,12 @@ typedef struct UIState {
   // sound scrollbar
   F32 scroll;
 
+  // evaluation profile overlay
+  Bool heatmap;
+
+  // the past beat shown while scrubbing
+  Index scrub_frame;
+
   // text interaction buffer
   Char text[LAYOUT_TEXT_INPUT];
   S32 text_head;
@@ -97,6 +106,8 @@ typedef struct RenderMetrics {
   U64 frame_time;       // in microseconds
   U64 frame_count;      // frames elapsed since startup
   Index render_index;   // index into history buffer
+  Index tape_beats;     // beats held for scrubbing
+  Index tape_bytes;
 } RenderMetrics;
 
 typedef struct LayoutParameters {
@@ -105,8 +116,9 @@ typedef struct LayoutParameters {
   V2S font_large;
   V2F mouse;
   const Model* model;
-  const GraphEdge* graph;
+  const Graph* graph;
   const DSPState* dsp;
+  const ModelProfile* profile;  // optional
   const RenderMetrics* metrics;
 } LayoutParameters;
 
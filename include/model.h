@@ -18,9 +18,12 @@
 #define MODEL_DEFAULT_X 0x40
 #define MODEL_DEFAULT_Y 0x40
 
-// the maximum number of graph edges we expect per tile
+// the most graph edges one operator records in a beat
 #define GRAPH_FACTOR 8
 
+// the longest frame period tracked before giving up
+#define MODEL_FRAME_PERIOD_LIMIT 0x100000
+
 // @rdk: This shouldn't be defined here.
 #define SIM_VOICES 0x200
 
@@ -56,8 +59,43 @@
 #define ATTRIBUTE_REGISTER "REGISTER"
 #define ATTRIBUTE_INDEX "INDEX"
 #define ATTRIBUTE_OUTPUT "OUTPUT"
+#define ATTRIBUTE_OCTAVE "OCTAVE"
+#define ATTRIBUTE_PITCH "PITCH"
+#define ATTRIBUTE_VOLUME "VOLUME"
+#define ATTRIBUTE_ATTACK "ATTACK"
+#define ATTRIBUTE_HOLD "HOLD"
+#define ATTRIBUTE_RELEASE "RELEASE"
+#define ATTRIBUTE_SOUND_INDEX "SOUND INDEX"
+#define ATTRIBUTE_START_TIME "START TIME"
+#define ATTRIBUTE_WAVEFORM "WAVEFORM"
+
+// packed cell layout
+#define CELL_TAG_MASK       0x003F
+#define CELL_POWERED        0x0040
+#define CELL_PULSE          0x0080
+#define CELL_LITERAL_SHIFT  8
+#define CELL_LITERAL_MAX    0xFF
+
+// bits per index word
+#define PLANE_BITS 64
+
+// tiles per side of a memory chunk
+#define MODEL_CHUNK 32
 
-#define MODEL_INDEX(m, cx, cy) ((m)->memory[(m)->dimensions.x * (cy) + (cx)])
+// the most lanes of concurrent evaluation
+#define MODEL_LANES 4
+
+// Program memory is padded with empty cells, so operand reads at a fixed
+// offset need no bounds check. Each row is followed by MODEL_APRON cells,
+// which serve as the east margin of that row and the west margin of the next,
+// and whole rows pad the grid to the north and south. The apron covers the
+// farthest fixed read, seven tiles west for SAMPLER. Writes are still
+// checked, so the padding stays empty.
+#define MODEL_APRON 8
+#define MODEL_STRIDE(d) ((d).x + MODEL_APRON)
+#define MODEL_CELLS(d) (MODEL_STRIDE(d) * ((d).y + 2) + MODEL_APRON)
+#define MODEL_OFFSET(d, cx, cy) (MODEL_STRIDE(d) * ((cy) + 1) + MODEL_APRON + (cx))
+#define MODEL_INDEX(m, cx, cy) ((m)->memory[MODEL_OFFSET((m)->dimensions, cx, cy)])
 
 // cardinal directions
 #define DIRECTION_NONE (-1)
@@ -105,7 +143,7 @@ typedef enum ValueTag {
   VALUE_TOP,
   VALUE_U,
   VALUE_V,
-  VALUE_W,
+  VALUE_WAVE,
   VALUE_SAMPLER,
   VALUE_SYNTH,
   VALUE_MIDI,
@@ -120,19 +158,182 @@ typedef struct Value {
   S32 literal;
 } Value;
 
+// Program memory stores values in a packed form. The low six bits hold the
+// tag, the next two bits hold the powered and pulse flags, and the high byte
+// holds the literal. Use the accessors below rather than the raw bits.
+typedef U16 Cell;
+
+// Zobrist-style hash of memory, the registers and the random number
+// generator, kept current by `model_set` and by evaluation. The frame counter
+// is left out, so a state that recurs on a later beat hashes alike. It lives
+// in the register file so that each history slot carries its own. Anything
+// that writes memory directly must recompute it with `model_hash`.
 typedef struct RegisterFile {
   Index frame;                            // beat counter
   rnd_pcg_t rnd;                          // random number generator
-  Value registers[MODEL_RADIX];           // register set
+  Cell registers[MODEL_RADIX];            // register set
+  U64 hash;                               // content hash
 } RegisterFile;
 
+// Bitplanes over program memory, one bit per tile, with each row padded to a
+// whole number of words. The index belongs to the evaluating thread and is
+// kept in sync with memory by `model_set`. The adjacency plane is maintained
+// as bangs come and go, so after `model_step` it marks exactly the tiles that
+// the simulation should trigger.
+//
+// The chunk plane has one bit per MODEL_CHUNK-square block of tiles. A chunk
+// is marked when a non-empty value is written into it and is never unmarked,
+// so every slot of memory that shares the index is empty outside the marked
+// chunks. Copies and comparisons of whole slots only visit marked chunks,
+// which keeps their cost proportional to the populated area. Splitting a
+// program into lanes marks the chunks its operators write to in advance, so
+// that lanes never modify the plane.
+// Memory itself stays dense, so each slot still holds the whole padded area.
+typedef struct ModelIndex {
+  Index stride;                           // words per row
+  U64* active;                            // operators and bangs
+  U64* bangs;                             // bangs
+  U64* adjacent;                          // tiles with a bang to one side
+  Index chunk_stride;                     // words per row of chunks
+  U64* chunks;                            // chunks that have held a value
+} ModelIndex;
+
+// An operator compiled against a fixed grid. Operands and output are
+// resolved to memory offsets. Operands off the grid land in the apron, and
+// an output off the grid is INDEX_NONE.
+// Operators with data-dependent offsets keep their tag and are evaluated by
+// the interpreter.
+typedef struct Instruction {
+  S32 input[3];
+  S32 output;
+  U16 x;
+  U16 y;
+  U8 tag;
+  U8 lane;
+} Instruction;
+
+// The operators in memory as a reading-order instruction stream. `model_set`
+// invalidates the stream when a write adds, removes, or changes an operator,
+// and evaluation falls back to the interpreter until it is recompiled at the
+// start of the next beat. Bangs written during a beat are not operators, but
+// the interpreter still visits them, so they are deferred in reading order.
+// The buffers hold `capacity` operators. A grid with more is interpreted,
+// and `operators` tells the owner how far to grow them. Requires an index.
+//
+// When the model has a pool, compilation also splits the stream into lanes.
+// Operators whose reads, writes and index words overlap share a lane, and
+// each lane runs in reading order on its own thread, so the result matches
+// serial evaluation. Operators on registers or the random number generator
+// share the first lane. An operator that reads or writes at an offset taken
+// from cell data touches every tile it can reach, and also runs in the first
+// lane. A program that can create or remove an operator during the beat is
+// not split.
+typedef struct ModelProgram {
+  Bool valid;
+  Index length;
+  Index capacity;                         // of each buffer below
+  Index operators;                        // found by the last compile
+  Instruction* instructions;              // one per operator
+  Index cursor;                           // last tile visited this beat
+  Index pending_head;
+  Index pending_length;
+  Index* pending;                         // deferred bangs, in reading order
+  Index lanes;                            // lanes in use, or zero for none
+  Index lane_length[MODEL_LANES];         // instructions per lane
+  Index* partition;                       // one per index word, then capacity
+} ModelProgram;
+
+// Runs tasks 0 to count - 1, possibly concurrently, and returns when all of
+// them have finished. The caller provides the threads.
+typedef struct ModelPool {
+  Void* context;
+  Void (*run)(Void* context, Void (*task)(Void* arg, Index lane), Void* arg, Index count);
+} ModelPool;
+
+// counts for one tile or one operator tag
+typedef struct ProfileCounter {
+  U32 fires;                              // evaluations, powered or banged
+  U32 reads;                              // operand reads
+  U32 writes;                             // writes to program memory
+  U64 ticks;                              // time spent evaluating, if timed
+} ProfileCounter;
+
+// Evaluation counters, accumulated by `model_step` when the model has a
+// profile. Each operator visited is charged both to its tile and to its tag.
+// The caller owns the window, clearing the counters and reading them as it
+// sees fit. Setting the clock adds timings, at the cost of two clock reads
+// per operator.
+//
+// Tiles are counted in an open-addressed table, keyed by the tile's offset
+// in reading order, so its size follows the operators rather than the grid.
+// Once the table is full, further tiles are charged only to their tags.
+typedef struct ModelProfile {
+  Index beats;                            // beats evaluated
+  U64 ticks;                              // time spent evaluating, if timed
+  U64 frequency;                          // clock ticks per second
+  ProfileCounter tags[VALUE_CARDINAL];
+  Index capacity;                         // table slots, a power of two
+  Index length;                           // table slots in use
+  Index* tiles;                           // tile of each slot, or INDEX_NONE
+  ProfileCounter* cells;                  // counters of each slot
+  Bool shared;                            // tiles are looked up, not added
+  U64 (*clock)(Void);                     // optional
+  ProfileCounter* tile;                   // operator under evaluation
+  ProfileCounter* tag;
+} ModelProfile;
+
+// CLOCK, DELAY and RANDOM make evaluation depend on the frame counter, each
+// with a period set by its operands. When the model has a frame period, every
+// such evaluation folds its period in as a least common multiple, so a run of
+// beats repeats exactly under a frame shift by any multiple of the result.
+// Periods past MODEL_FRAME_PERIOD_LIMIT saturate to zero, meaning none.
+
+// With no index and no program, `model_step` visits every tile in reading
+// order. That path is the reference interpreter, and it should stay simple.
+// Each optional structure enables a faster engine, and src/differ.c steps
+// random grids on every engine and checks them against the reference. The
+// reference marks pulse on every unpowered tile beside a bang, but the other
+// engines visit only active tiles, so they leave pulse off empty and literal
+// tiles. The renderer draws pulse only on operators, and the differ ignores
+// it on inactive tiles and in the registers, which hold copies of tiles.
+
 // @rdk: This can probably be replaced by the program history structure.
 typedef struct Model {
   V2S dimensions;
   RegisterFile* register_file;
-  Value* memory;
+  Cell* memory;
+  ModelIndex* index;                      // optional
+  ModelProgram* program;                  // optional
+  Index* frame_period;                    // optional
+  const ModelPool* pool;                  // optional, requires a program
+  ModelProfile* profile;                  // optional
 } Model;
 
+// Variants of one grid, evaluated in lockstep for parameter sweeps. Memory is
+// interleaved by variant, so each tile holds MODEL_BATCH cells side by side
+// and one pass of an operator covers every variant. The variants must agree
+// on where every operator is and what it is, and may differ in data, power,
+// registers and random state. Which operators fire is decided per variant,
+// and variants that do not fire are masked out of the write.
+//
+// The stream is the program of the shared layout, with a visit added at each
+// tile an operator may bang, in reading order. A program that could move an
+// operator, or that reads or writes at an offset taken from cell data, would
+// part the variants, so it is refused. Hashes are not kept during a batch,
+// and are recomputed when a variant is stored back into a model.
+#define MODEL_BATCH 8
+#define MODEL_BATCH_CELLS(d) (MODEL_CELLS(d) * MODEL_BATCH)
+#define MODEL_BATCH_STREAM(d) (2 * (d).x * (d).y)
+
+typedef struct ModelBatch {
+  V2S dimensions;
+  Index variants;                         // in use, at most MODEL_BATCH
+  Cell* memory;                           // MODEL_BATCH_CELLS, by tile then variant
+  RegisterFile register_files[MODEL_BATCH];
+  Index length;
+  Instruction* stream;                    // MODEL_BATCH_STREAM, at most
+} ModelBatch;
+
 #if 0
 // state stored on disk
 typedef struct ModelStorage {
@@ -150,32 +351,100 @@ typedef enum GraphEdgeTag {
   GRAPH_EDGE_CARDINAL,
 } GraphEdgeTag;
 
+// operand names, indexing `graph_attribute_table`
+typedef enum GraphAttribute {
+  GRAPH_ATTRIBUTE_NONE,
+  GRAPH_ATTRIBUTE_LEFT_ADDEND,
+  GRAPH_ATTRIBUTE_RIGHT_ADDEND,
+  GRAPH_ATTRIBUTE_MINUEND,
+  GRAPH_ATTRIBUTE_SUBTRAHEND,
+  GRAPH_ATTRIBUTE_MULTIPLIER,
+  GRAPH_ATTRIBUTE_MULTIPLICAND,
+  GRAPH_ATTRIBUTE_DIVIDEND,
+  GRAPH_ATTRIBUTE_DIVISOR,
+  GRAPH_ATTRIBUTE_LEFT_COMPARATE,
+  GRAPH_ATTRIBUTE_RIGHT_COMPARATE,
+  GRAPH_ATTRIBUTE_LEFT_CONJUNCT,
+  GRAPH_ATTRIBUTE_RIGHT_CONJUNCT,
+  GRAPH_ATTRIBUTE_LEFT_DISJUNCT,
+  GRAPH_ATTRIBUTE_RIGHT_DISJUNCT,
+  GRAPH_ATTRIBUTE_MINIMUM,
+  GRAPH_ATTRIBUTE_MAXIMUM,
+  GRAPH_ATTRIBUTE_RATE,
+  GRAPH_ATTRIBUTE_TIME,
+  GRAPH_ATTRIBUTE_X,
+  GRAPH_ATTRIBUTE_Y,
+  GRAPH_ATTRIBUTE_INPUT,
+  GRAPH_ATTRIBUTE_REGISTER,
+  GRAPH_ATTRIBUTE_INDEX,
+  GRAPH_ATTRIBUTE_OCTAVE,
+  GRAPH_ATTRIBUTE_PITCH,
+  GRAPH_ATTRIBUTE_VOLUME,
+  GRAPH_ATTRIBUTE_ATTACK,
+  GRAPH_ATTRIBUTE_HOLD,
+  GRAPH_ATTRIBUTE_RELEASE,
+  GRAPH_ATTRIBUTE_SOUND_INDEX,
+  GRAPH_ATTRIBUTE_START_TIME,
+  GRAPH_ATTRIBUTE_WAVEFORM,
+  GRAPH_ATTRIBUTE_OUTPUT,
+  GRAPH_ATTRIBUTE_CARDINAL,
+} GraphAttribute;
+
+// An edge from an operator to a tile it read or wrote. The target is stored
+// relative to the origin. Operators only write their output, so the edge
+// direction follows from the attribute.
 typedef struct GraphEdge {
-  GraphEdgeTag tag;
-  V2S origin;
-  V2S target;
-  ValueTag cause;
-  const Char* attribute;
+  U16 x;                                  // origin
+  U16 y;
+  S8 dx;                                  // target, relative to origin
+  S8 dy;
+  U8 cause;                               // ValueTag of the operator
+  U8 attribute;                           // GraphAttribute
 } GraphEdge;
 
-#if 0
+_Static_assert(sizeof(GraphEdge) == 8, "graph edges should pack into 8 bytes");
+
+// edges recorded during a single beat
 typedef struct Graph {
   Index capacity;
-  Index head;
+  Index head;                             // number of edges recorded
   GraphEdge* edges;
 } Graph;
-#endif
+
+// the most operands a sounding operator reads, west of itself
+#define EVENT_OPERANDS 7
+
+// A sounding operator beside a bang, with the tiles to its west as they were
+// on that beat. `operands[0]` is the nearest. Operands are whole cells, less
+// the pulse, since each consumer applies its own defaults to non-literals.
+typedef struct ModelEvent {
+  Index frame;                            // beat that fired it
+  V2S origin;
+  ValueTag tag;                           // SYNTH, SAMPLER or MIDI
+  Cell operands[EVENT_OPERANDS];
+} ModelEvent;
+
+// caller-provided event buffer
+typedef struct EventSink {
+  Index capacity;
+  Index head;                             // number of events recorded
+  Index dropped;                          // events that did not fit
+  ModelEvent* events;
+} EventSink;
 
 typedef struct ProgramHistory {
   V2S dimensions;
   RegisterFile* register_file;
-  Value* memory;
-  GraphEdge* graph;
+  Cell* memory;
+  ModelIndex index;                       // shared by all slots
+  ModelProgram program;                   // shared by all slots
+  Cell* snapshot;                         // scratch slot, for the simulation
+  Cell* previous;                         // scratch slot, for the simulation
+  ModelProfile* profiles;                 // profile windows, see sim.h
 } ProgramHistory;
 
 // @rdk: This shouldn't be defined here.
 typedef struct DSPSamplerVoice {
-  Bool active;
   Index sound;
   F32 frame;
   Index length;
@@ -184,9 +453,76 @@ typedef struct DSPSamplerVoice {
 // @rdk: This shouldn't be defined here.
 typedef struct DSPState {
   S32 tempo;
+  Index voice_count;                      // sounding voices, the first of `voices`
   DSPSamplerVoice voices[SIM_VOICES];
 } DSPState;
 
+_Static_assert(VALUE_CARDINAL <= CELL_TAG_MASK + 1, "cell tag field too narrow");
+_Static_assert(MODEL_RADIX <= CELL_LITERAL_MAX + 1, "cell literal field too narrow");
+
+static inline ValueTag cell_tag(Cell cell)
+{
+  return (ValueTag) (cell & CELL_TAG_MASK);
+}
+
+static inline Bool cell_powered(Cell cell)
+{
+  return (cell & CELL_POWERED) != 0;
+}
+
+static inline Bool cell_pulse(Cell cell)
+{
+  return (cell & CELL_PULSE) != 0;
+}
+
+static inline S32 cell_literal(Cell cell)
+{
+  return (S32) (cell >> CELL_LITERAL_SHIFT);
+}
+
+static inline Cell cell_of_value(Value value)
+{
+  ASSERT(value.literal >= 0 && value.literal <= CELL_LITERAL_MAX);
+  const U32 tag = (U32) value.tag;
+  const U32 powered = value.powered ? CELL_POWERED : 0;
+  const U32 pulse = value.pulse ? CELL_PULSE : 0;
+  const U32 literal = (U32) value.literal << CELL_LITERAL_SHIFT;
+  return (Cell) (tag | powered | pulse | literal);
+}
+
+static inline Value value_of_cell(Cell cell)
+{
+  Value out;
+  out.tag = cell_tag(cell);
+  out.powered = cell_powered(cell);
+  out.pulse = cell_pulse(cell);
+  out.literal = cell_literal(cell);
+  return out;
+}
+
+static inline GraphEdgeTag graph_edge_tag(GraphEdge edge)
+{
+  return edge.attribute == GRAPH_ATTRIBUTE_OUTPUT ? GRAPH_EDGE_OUTPUT : GRAPH_EDGE_INPUT;
+}
+
+static inline V2S graph_edge_origin(GraphEdge edge)
+{
+  return v2s(edge.x, edge.y);
+}
+
+static inline V2S graph_edge_target(GraphEdge edge)
+{
+  return v2s(edge.x + edge.dx, edge.y + edge.dy);
+}
+
+// names of graph attributes
+extern const Char* const graph_attribute_table[GRAPH_ATTRIBUTE_CARDINAL];
+
+// The operator or the literal a character enters, else VALUE_NONE or -1. The
+// editor and grid files share these.
+ValueTag character_tag(Char c);
+S32 character_literal(Char c);
+
 // constant values
 extern const Value value_none;
 extern const Value value_bang;
@@ -214,6 +550,7 @@ extern const Value value_quote;
 extern const Value value_random;
 extern const Value value_store;
 extern const Value value_top;
+extern const Value value_wave;
 extern const Value value_sampler;
 extern const Value value_synth;
 
@@ -241,6 +578,72 @@ Void model_set(Model* m, V2S point, Value value);
 // read a value
 Value model_get(const Model* m, V2S point);
 
+// read a value within MODEL_APRON tiles of the grid, without a bounds check
+Value model_peek(const Model* m, V2S point);
+
+// the point at a memory offset inside the grid
+V2S model_point(V2S dimensions, Index offset);
+
+// number of words in each index plane
+Index model_index_words(V2S dimensions);
+
+// recompute the index after writing memory directly
+Void model_index_rebuild(Model* m);
+
+// number of words in the chunk plane
+Index model_chunk_words(V2S dimensions);
+
+// Find the next run of marked chunks on a row of tiles, searching from *end.
+// The run is returned in tiles, as [*begin, *end). Start with *end at zero.
+Bool model_chunk_run(const ModelIndex* index, V2S dimensions, S32 y, S32* begin, S32* end);
+
+// copy or compare the marked chunks of two memory slots
+Void model_chunk_copy(const ModelIndex* index, V2S dimensions, Cell* dst, const Cell* src);
+Bool model_chunk_equal(const ModelIndex* index, V2S dimensions, const Cell* a, const Cell* b);
+
+// compute one row of the adjacency plane from three rows of the bang plane
+Void model_index_adjacency_row(
+    U64* out,
+    const U64* north,
+    const U64* row,
+    const U64* south,
+    Index stride,
+    S32 width);
+
 // evaluator
 Void model_init(Model* m);
-Void model_step(Model* m, GraphEdge* graph);
+U64 model_hash(const Model* m);                     // from scratch
+
+// Advance one beat. The graph and the event sink are optional. The events of
+// the beat are appended to the sink in reading order, and the sink is not
+// reset, so that it can gather several beats.
+Void model_step(Model* m, Graph* graph, EventSink* events);
+
+// empty a profile, keeping its clock and its table
+Void model_profile_clear(ModelProfile* profile);
+
+// operators in memory, which a program needs room for
+Index model_operators(const Model* m);
+
+// Advance n beats without recording a graph, appending the events of each
+// beat to the sink.
+Void model_step_n(Model* m, Index n, EventSink* sink);
+
+// Record the dataflow graph of the next beat without modifying the program.
+// The scratch buffer must hold as many cells as the program's memory.
+Void model_graph(const Model* m, Cell* scratch, Graph* graph);
+
+// The offset of the first operator that stops a grid from running in a batch,
+// or INDEX_NONE if it can.
+Index model_batch_conflict(const Model* m);
+
+// Copy variants into a batch, returning false if the grid cannot run in a
+// batch or the variants disagree on an operator. The batch's memory and
+// stream must be allocated for the variants' dimensions.
+Bool model_batch_load(ModelBatch* batch, const Model* variants, Index count);
+
+// Advance every variant one beat. The sinks are optional, one per variant.
+Void model_batch_step(ModelBatch* batch, EventSink* sinks);
+
+// copy a variant back into a model, rebuilding its hash and index
+Void model_batch_store(const ModelBatch* batch, Index variant, Model* m);
@@ -9,6 +9,10 @@
 #include <stddef.h>
 #include <assert.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 /*******************************************************************************
  * TYPE DEFINITIONS
  ******************************************************************************/
@@ -84,6 +88,417 @@ typedef ptrdiff_t Index;
 // division rounding towards negative infinity when d < 0
 #define KNUTH_DIV(n, d) ((n) >= 0 ? (n) / (d) : ((n) - (d) + 1) / (d))
 
+/*******************************************************************************
+ * BIT MANIPULATION
+ ******************************************************************************/
+
+// index of the lowest set bit; the argument must be nonzero
+static inline S32 u64_trailing_zeros(U64 x)
+{
+  ASSERT(x != 0);
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward64(&index, x);
+  return (S32) index;
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+/*******************************************************************************
+ * SIMD
+ ******************************************************************************/
+
+// Four lanes of 32 bits. Kernels use them only through the functions below,
+// which map to the vector extensions of gcc and clang, or to SSE2 under MSVC
+// on x64. Each kernel keeps a scalar loop, which runs on its own when SIMD is
+// 0 and finishes the frames left over when it is 1.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD 1
+#define SIMD_LANES 4
+
+typedef F32 F32x4 __attribute__((vector_size(16)));
+typedef U32 U32x4 __attribute__((vector_size(16)));
+typedef S32 S32x4 __attribute__((vector_size(16)));
+
+static inline F32x4 f32x4_load(const F32* p)
+{
+  F32x4 v;
+  __builtin_memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline Void f32x4_store(F32* p, F32x4 v)
+{
+  __builtin_memcpy(p, &v, sizeof(v));
+}
+
+static inline F32x4 f32x4_set(F32 a, F32 b, F32 c, F32 d)
+{
+  return (F32x4) { a, b, c, d };
+}
+
+static inline F32x4 f32x4_splat(F32 a)
+{
+  return (F32x4) { a, a, a, a };
+}
+
+static inline F32x4 f32x4_add(F32x4 a, F32x4 b)
+{
+  return a + b;
+}
+
+static inline F32x4 f32x4_sub(F32x4 a, F32x4 b)
+{
+  return a - b;
+}
+
+static inline F32x4 f32x4_mul(F32x4 a, F32x4 b)
+{
+  return a * b;
+}
+
+// lanes below 2^31
+static inline F32x4 f32x4_of_u32x4(U32x4 a)
+{
+  return __builtin_convertvector((S32x4) a, F32x4);
+}
+
+static inline Void u32x4_store(U32* p, U32x4 v)
+{
+  __builtin_memcpy(p, &v, sizeof(v));
+}
+
+static inline U32x4 u32x4_set(U32 a, U32 b, U32 c, U32 d)
+{
+  return (U32x4) { a, b, c, d };
+}
+
+static inline U32x4 u32x4_splat(U32 a)
+{
+  return (U32x4) { a, a, a, a };
+}
+
+static inline U32x4 u32x4_add(U32x4 a, U32x4 b)
+{
+  return a + b;
+}
+
+static inline U32x4 u32x4_and(U32x4 a, U32x4 b)
+{
+  return a & b;
+}
+
+static inline U32x4 u32x4_shr(U32x4 a, S32 bits)
+{
+  return a >> bits;
+}
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD 1
+#define SIMD_LANES 4
+
+typedef __m128 F32x4;
+typedef __m128i U32x4;
+
+static inline F32x4 f32x4_load(const F32* p)
+{
+  return _mm_loadu_ps(p);
+}
+
+static inline Void f32x4_store(F32* p, F32x4 v)
+{
+  _mm_storeu_ps(p, v);
+}
+
+static inline F32x4 f32x4_set(F32 a, F32 b, F32 c, F32 d)
+{
+  return _mm_setr_ps(a, b, c, d);
+}
+
+static inline F32x4 f32x4_splat(F32 a)
+{
+  return _mm_set1_ps(a);
+}
+
+static inline F32x4 f32x4_add(F32x4 a, F32x4 b)
+{
+  return _mm_add_ps(a, b);
+}
+
+static inline F32x4 f32x4_sub(F32x4 a, F32x4 b)
+{
+  return _mm_sub_ps(a, b);
+}
+
+static inline F32x4 f32x4_mul(F32x4 a, F32x4 b)
+{
+  return _mm_mul_ps(a, b);
+}
+
+// lanes below 2^31
+static inline F32x4 f32x4_of_u32x4(U32x4 a)
+{
+  return _mm_cvtepi32_ps(a);
+}
+
+static inline Void u32x4_store(U32* p, U32x4 v)
+{
+  _mm_storeu_si128((__m128i*) p, v);
+}
+
+static inline U32x4 u32x4_set(U32 a, U32 b, U32 c, U32 d)
+{
+  return _mm_setr_epi32((int) a, (int) b, (int) c, (int) d);
+}
+
+static inline U32x4 u32x4_splat(U32 a)
+{
+  return _mm_set1_epi32((int) a);
+}
+
+static inline U32x4 u32x4_add(U32x4 a, U32x4 b)
+{
+  return _mm_add_epi32(a, b);
+}
+
+static inline U32x4 u32x4_and(U32x4 a, U32x4 b)
+{
+  return _mm_and_si128(a, b);
+}
+
+static inline U32x4 u32x4_shr(U32x4 a, S32 bits)
+{
+  return _mm_srl_epi32(a, _mm_cvtsi32_si128(bits));
+}
+#else
+#define SIMD 0
+#endif
+
+// Eight lanes of 16 bits, holding the cells of one tile across a batch of
+// grid variants. Comparisons give lanes of all ones or all zeros, and treat
+// lanes as signed, so `gt`, `min` and `max` need lanes below 0x8000. Without
+// SIMD a vector is an array, and each helper loops over it.
+#if defined(__GNUC__) || defined(__clang__)
+
+typedef U16 U16x8 __attribute__((vector_size(16)));
+typedef S16 S16x8 __attribute__((vector_size(16)));
+typedef U32 U32x8 __attribute__((vector_size(32)));
+
+static inline U16x8 u16x8_load(const U16* p)
+{
+  U16x8 v;
+  __builtin_memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline Void u16x8_store(U16* p, U16x8 v)
+{
+  __builtin_memcpy(p, &v, sizeof(v));
+}
+
+static inline U16x8 u16x8_splat(U16 a)
+{
+  return (U16x8) { a, a, a, a, a, a, a, a };
+}
+
+static inline U16x8 u16x8_and(U16x8 a, U16x8 b)
+{
+  return a & b;
+}
+
+static inline U16x8 u16x8_or(U16x8 a, U16x8 b)
+{
+  return a | b;
+}
+
+static inline U16x8 u16x8_add(U16x8 a, U16x8 b)
+{
+  return a + b;
+}
+
+static inline U16x8 u16x8_sub(U16x8 a, U16x8 b)
+{
+  return a - b;
+}
+
+static inline U16x8 u16x8_mul(U16x8 a, U16x8 b)
+{
+  return a * b;
+}
+
+// the high half of each 32-bit product
+static inline U16x8 u16x8_mulhi(U16x8 a, U16x8 b)
+{
+  const U32x8 product = __builtin_convertvector(a, U32x8) * __builtin_convertvector(b, U32x8);
+  return __builtin_convertvector(product >> 16, U16x8);
+}
+
+static inline U16x8 u16x8_shl(U16x8 a, S32 bits)
+{
+  return a << bits;
+}
+
+static inline U16x8 u16x8_shr(U16x8 a, S32 bits)
+{
+  return a >> bits;
+}
+
+static inline U16x8 u16x8_eq(U16x8 a, U16x8 b)
+{
+  return (U16x8) (a == b);
+}
+
+static inline U16x8 u16x8_gt(U16x8 a, U16x8 b)
+{
+  return (U16x8) ((S16x8) a > (S16x8) b);
+}
+
+// lanes of `a` where `mask` is set, and of `b` elsewhere
+static inline U16x8 u16x8_select(U16x8 mask, U16x8 a, U16x8 b)
+{
+  return (a & mask) | (b & ~mask);
+}
+
+static inline U16x8 u16x8_min(U16x8 a, U16x8 b)
+{
+  return u16x8_select(u16x8_gt(a, b), b, a);
+}
+
+static inline U16x8 u16x8_max(U16x8 a, U16x8 b)
+{
+  return u16x8_select(u16x8_gt(a, b), a, b);
+}
+
+#elif defined(_MSC_VER) && defined(_M_X64)
+
+typedef __m128i U16x8;
+
+static inline U16x8 u16x8_load(const U16* p)
+{
+  return _mm_loadu_si128((const __m128i*) p);
+}
+
+static inline Void u16x8_store(U16* p, U16x8 v)
+{
+  _mm_storeu_si128((__m128i*) p, v);
+}
+
+static inline U16x8 u16x8_splat(U16 a)
+{
+  return _mm_set1_epi16((short) a);
+}
+
+static inline U16x8 u16x8_and(U16x8 a, U16x8 b)
+{
+  return _mm_and_si128(a, b);
+}
+
+static inline U16x8 u16x8_or(U16x8 a, U16x8 b)
+{
+  return _mm_or_si128(a, b);
+}
+
+static inline U16x8 u16x8_add(U16x8 a, U16x8 b)
+{
+  return _mm_add_epi16(a, b);
+}
+
+static inline U16x8 u16x8_sub(U16x8 a, U16x8 b)
+{
+  return _mm_sub_epi16(a, b);
+}
+
+static inline U16x8 u16x8_mul(U16x8 a, U16x8 b)
+{
+  return _mm_mullo_epi16(a, b);
+}
+
+// the high half of each 32-bit product
+static inline U16x8 u16x8_mulhi(U16x8 a, U16x8 b)
+{
+  return _mm_mulhi_epu16(a, b);
+}
+
+static inline U16x8 u16x8_shl(U16x8 a, S32 bits)
+{
+  return _mm_sll_epi16(a, _mm_cvtsi32_si128(bits));
+}
+
+static inline U16x8 u16x8_shr(U16x8 a, S32 bits)
+{
+  return _mm_srl_epi16(a, _mm_cvtsi32_si128(bits));
+}
+
+static inline U16x8 u16x8_eq(U16x8 a, U16x8 b)
+{
+  return _mm_cmpeq_epi16(a, b);
+}
+
+static inline U16x8 u16x8_gt(U16x8 a, U16x8 b)
+{
+  return _mm_cmpgt_epi16(a, b);
+}
+
+// lanes of `a` where `mask` is set, and of `b` elsewhere
+static inline U16x8 u16x8_select(U16x8 mask, U16x8 a, U16x8 b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline U16x8 u16x8_min(U16x8 a, U16x8 b)
+{
+  return _mm_min_epi16(a, b);
+}
+
+static inline U16x8 u16x8_max(U16x8 a, U16x8 b)
+{
+  return _mm_max_epi16(a, b);
+}
+
+#else
+
+typedef struct U16x8 { U16 lanes[8]; } U16x8;
+
+#define U16X8_LANES(expression) \
+  U16x8 out; \
+  for (S32 l = 0; l < 8; l++) { \
+    out.lanes[l] = (U16) (expression); \
+  } \
+  return out
+
+static inline U16x8 u16x8_load(const U16* p) { U16X8_LANES(p[l]); }
+static inline U16x8 u16x8_splat(U16 a) { U16X8_LANES(a); }
+static inline U16x8 u16x8_and(U16x8 a, U16x8 b) { U16X8_LANES(a.lanes[l] & b.lanes[l]); }
+static inline U16x8 u16x8_or(U16x8 a, U16x8 b) { U16X8_LANES(a.lanes[l] | b.lanes[l]); }
+static inline U16x8 u16x8_add(U16x8 a, U16x8 b) { U16X8_LANES(a.lanes[l] + b.lanes[l]); }
+static inline U16x8 u16x8_sub(U16x8 a, U16x8 b) { U16X8_LANES(a.lanes[l] - b.lanes[l]); }
+static inline U16x8 u16x8_mul(U16x8 a, U16x8 b) { U16X8_LANES(a.lanes[l] * b.lanes[l]); }
+static inline U16x8 u16x8_mulhi(U16x8 a, U16x8 b) { U16X8_LANES(((U32) a.lanes[l] * b.lanes[l]) >> 16); }
+static inline U16x8 u16x8_shl(U16x8 a, S32 bits) { U16X8_LANES(a.lanes[l] << bits); }
+static inline U16x8 u16x8_shr(U16x8 a, S32 bits) { U16X8_LANES(a.lanes[l] >> bits); }
+static inline U16x8 u16x8_eq(U16x8 a, U16x8 b) { U16X8_LANES(a.lanes[l] == b.lanes[l] ? 0xFFFF : 0); }
+static inline U16x8 u16x8_gt(U16x8 a, U16x8 b) { U16X8_LANES((S16) a.lanes[l] > (S16) b.lanes[l] ? 0xFFFF : 0); }
+static inline U16x8 u16x8_min(U16x8 a, U16x8 b) { U16X8_LANES((S16) a.lanes[l] > (S16) b.lanes[l] ? b.lanes[l] : a.lanes[l]); }
+static inline U16x8 u16x8_max(U16x8 a, U16x8 b) { U16X8_LANES((S16) a.lanes[l] > (S16) b.lanes[l] ? a.lanes[l] : b.lanes[l]); }
+
+// lanes of `a` where `mask` is set, and of `b` elsewhere
+static inline U16x8 u16x8_select(U16x8 mask, U16x8 a, U16x8 b)
+{
+  U16X8_LANES((a.lanes[l] & mask.lanes[l]) | (b.lanes[l] & ~mask.lanes[l]));
+}
+
+static inline Void u16x8_store(U16* p, U16x8 v)
+{
+  for (S32 l = 0; l < 8; l++) {
+    p[l] = v.lanes[l];
+  }
+}
+
+#undef U16X8_LANES
+
+#endif
+
 /*******************************************************************************
  * INTEGER VECTORS
  ******************************************************************************/
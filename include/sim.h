@@ -5,11 +5,57 @@
 #pragma once
 
 #include "model.h"
+#include "comms.h"
 
 #define SIM_HISTORY 0x20
 
+// Evaluation profile windows. The audio thread publishes a window once it
+// covers SIM_PROFILE_BEATS beats and the render thread has one to give back.
+#define SIM_PROFILES 3
+#define SIM_PROFILE_BEATS 0x20
+
+// Programs in the rack. Each instance has its own history, tempo and voices,
+// and the audio thread steps them side by side on its workers, in blocks of
+// at most SIM_BLOCK frames, before mixing them into one output.
+#define SIM_INSTANCES 4
+#define SIM_BLOCK 0x400
+
+#define SIM_DEFAULT_TEMPO 80
+
+// the fewest operators a history's program has room for
+#define SIM_PROGRAM_CAPACITY 0x100
+
+// the render thread's end of one instance
+typedef struct SimChannel {
+  ATOMIC_QUEUE_TYPE(Index)* allocation_queue;
+  ATOMIC_QUEUE_TYPE(Index)* free_queue;
+  ATOMIC_QUEUE_TYPE(Index)* profile_queue;
+  ATOMIC_QUEUE_TYPE(Index)* profile_free_queue;
+  ATOMIC_QUEUE_TYPE(Index)* dsp_queue;
+  ATOMIC_QUEUE_TYPE(Index)* dsp_free_queue;
+  ATOMIC_QUEUE_TYPE(ControlMessage)* control_queue;
+  ATOMIC_QUEUE_TYPE(ControlMessage)* retire_queue;    // see retire_queue
+  DSPState* dsp_history;                  // SIM_HISTORY entries, see dsp_queue
+} SimChannel;
+
 extern DSPState dsp_history[SIM_HISTORY];
 
+// Called from render thread, before handing the history to the audio thread.
+// The program and profile buffers are sized for the operators given, with
+// room to spare, rather than for the grid.
+ProgramHistory sim_allocate_history(S32 length, V2S dimensions, Index operators);
+
+// the one-slot history a period writes when no slot is free, which holds only
+// a register file and memory
+ProgramHistory sim_allocate_secondary(V2S dimensions);
+
+// called from render thread, once the audio thread no longer holds the history
+Void sim_free_history(ProgramHistory* history);
+
+// called from render thread, before the audio thread starts
+Void sim_init(Void);
+Index sim_attach(SimChannel channel, ProgramHistory primary, ProgramHistory secondary); // INDEX_NONE if full
+
 // called from audio thread
-Void sim_init(ProgramHistory primary, ProgramHistory secondary);
 Void sim_step(F32* audio_out, Index frames);
+Index sim_beat_frames(Index instance);              // at its current tempo
@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * tape.h - beat history for scrubbing
+ *
+ * The render thread records every beat the audio thread publishes. Every
+ * TAPE_KEYFRAME beats the tape stores the whole grid. The beats in between
+ * store only the tiles and registers that changed since the beat before.
+ * Both kinds are the same encoding: a keyframe is a diff against an empty
+ * grid. Each changed tile costs a varint gap and its cell. Entries live in a
+ * byte ring, and the oldest are dropped as it fills, back to a keyframe.
+ *
+ * Reading a beat decodes its keyframe and then the diffs up to it. Stepping
+ * forward from the last beat read applies a single diff.
+ ******************************************************************************/
+
+#pragma once
+
+#include "model.h"
+
+#define TAPE_BEATS 0x2000
+#define TAPE_KEYFRAME 0x40
+#define TAPE_BYTES 0x1000000
+
+typedef struct TapeEntry {
+  Index frame;                            // the beat recorded
+  Index offset;                           // into the byte ring
+  Index length;
+  Bool keyframe;
+} TapeEntry;
+
+typedef struct Tape {
+  V2S dimensions;
+  TapeEntry* entries;                     // TAPE_BEATS, by sequence number
+  Index first;                            // sequence number of the oldest
+  Index count;                            // sequence number past the newest
+  U8* bytes;                              // TAPE_BYTES
+  Index write;                            // next byte of the ring
+  U8* scratch;                            // room for the largest entry
+  Cell* current;                          // the beat being recorded, one cell per tile
+  Cell* last;                             // the newest beat recorded
+  RegisterFile last_registers;
+  Cell* view;                             // the beat last read, as memory
+  RegisterFile view_registers;
+  Index view_sequence;                    // INDEX_NONE if none
+} Tape;
+
+Tape tape_allocate(V2S dimensions);
+Void tape_free(Tape* tape);
+Void tape_clear(Tape* tape);
+Void tape_record(Tape* tape, const Model* m);       // once per published slot
+Index tape_bytes(const Tape* tape);                 // encoded size held
+
+// the newest recorded beat at or before `frame`, false if none
+Bool tape_read(Tape* tape, Index frame, Model* out);
+Index tape_first_frame(const Tape* tape);           // INDEX_NONE if empty
+Index tape_last_frame(const Tape* tape);
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * undo.h - edit history
+ *
+ * Each edit is a step over a rectangle of tiles: one tile for a write or a
+ * power toggle, and the whole grid for a clear. The render thread reserves
+ * room for the step, and the audio thread fills it in as it applies the edit,
+ * with the cells the edit replaced and then the cells it wrote. Undo and redo
+ * write one or the other back to those tiles only, so the rest of the grid
+ * keeps evaluating undisturbed, and each of several edits sent before the
+ * display catches up keeps the cell it really replaced.
+ *
+ * Steps are kept in the order they were made, in one ring of storage. A new
+ * edit forgets the steps undone before it, and the oldest steps give up their
+ * room to new ones. Only the audio thread reads or writes the cells, in the
+ * order of the control queue, so the render thread can reuse the room of a
+ * forgotten step as soon as it has sent the messages that mention it.
+ ******************************************************************************/
+
+#pragma once
+
+#include "model.h"
+
+// steps kept
+#define UNDO_DEPTH 0x1000
+
+// storage, in cells, two for each tile of each step
+#define UNDO_CELLS 0x400000
+
+typedef struct UndoStep {
+  V2S dimensions;                         // of the grid the step was made on
+  V2S origin;
+  V2S size;                               // empty if the edit is not recorded
+  Index cells;                            // replaced cells, then written ones
+} UndoStep;
+
+// Called from render thread. Recording fails only for an edit too large for
+// the storage, which then forgets every step, since none can be undone past
+// the edit.
+Void undo_reset(Void);                                  // on resize
+Bool undo_record(V2S dimensions, V2S origin, V2S size, UndoStep* step);
+Bool undo_back(UndoStep* step);                         // false if no history
+Bool undo_forward(UndoStep* step);
+
+// called from audio thread, around an edit and to apply a step
+Void undo_before(const Model* m, const UndoStep* step);
+Void undo_after(const Model* m, const UndoStep* step);
+Void undo_restore(Model* m, const UndoStep* step, Bool forward);
@@ -24,6 +24,7 @@
 #include "config.h"
 #include "comms.h"
 #include "layout.h"
+#include "tape.h"
 #include "stb_truetype.h"
 #include "dr_wav.h"
 #include "font.ttf.h"
@@ -75,6 +76,7 @@ static Font font_large = {0};
 static Texture waveforms[MODEL_RADIX] = {0};
 
 static ProgramHistory program_history = {0};
+static Tape tape = {0};
 static UIState ui = {
   .cursor = { MODEL_DEFAULT_X / 2, MODEL_DEFAULT_Y / 2 },
   .camera = { MODEL_DEFAULT_X / 2.f, MODEL_DEFAULT_Y / 2.f },
@@ -84,6 +86,19 @@ static RenderMetrics metrics = {0};
 
 static Index render_index = 0;
 
+// the latest evaluation profile window, if any
+static Index render_profile = INDEX_NONE;
+
+// index into dsp history buffer
+static Index render_dsp = 0;
+
+// dataflow graph of the displayed program, derived on the render thread
+static Graph render_graph = {0};
+static Cell* render_graph_scratch = NULL;
+static V2S render_graph_dimensions = {0};
+static const Cell* render_graph_source = NULL;
+static Index render_graph_frame = INDEX_NONE;
+
 static U64 frame_begin = 0;
 static U64 frame_count = 0;
 
@@ -96,42 +111,16 @@ static InteractionRectangle interaction_buffer[LAYOUT_INTERACTION_RECTANGLES] =
 // queue buffers
 static Index allocation_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
 static Index free_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
+static Index profile_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
+static Index profile_free_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
+static Index dsp_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
+static Index dsp_free_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
 static ControlMessage control_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
+static ControlMessage retire_queue_buffer[MESSAGE_QUEUE_CAPACITY] = {0};
 
 // half a second of audio should always be enough
 static F32 stream_buffer[Config_AUDIO_SAMPLE_RATE] = {0};
 
-static ValueTag value_table[CHAR_MAX + 1] = {
-  [ '!' ]       = VALUE_BANG       ,
-  [ '+' ]       = VALUE_ADD        ,
-  [ '-' ]       = VALUE_SUB        ,
-  [ '*' ]       = VALUE_MUL        ,
-  [ '/' ]       = VALUE_DIV        ,
-  [ '=' ]       = VALUE_EQUAL      ,
-  [ '>' ]       = VALUE_GREATER    ,
-  [ '<' ]       = VALUE_LESSER     ,
-  [ '&' ]       = VALUE_AND        ,
-  [ '|' ]       = VALUE_OR         ,
-  [ 'a' ]       = VALUE_ALTER      ,
-  [ 'b' ]       = VALUE_BOTTOM     ,
-  [ 'c' ]       = VALUE_CLOCK      ,
-  [ 'd' ]       = VALUE_DELAY      ,
-  [ 'h' ]       = VALUE_HOP        ,
-  [ 'i' ]       = VALUE_INTERFERE  ,
-  [ 'j' ]       = VALUE_JUMP       ,
-  [ 'l' ]       = VALUE_LOAD       ,
-  [ 'm' ]       = VALUE_MULTIPLEX  ,
-  [ 'n' ]       = VALUE_NOTE       ,
-  [ 'o' ]       = VALUE_ODDMENT    ,
-  [ 'q' ]       = VALUE_QUOTE      ,
-  [ 'r' ]       = VALUE_RANDOM     ,
-  [ 's' ]       = VALUE_STORE      ,
-  [ 't' ]       = VALUE_TOP        ,
-  [ 'x' ]       = VALUE_SAMPLER    ,
-  [ 'y' ]       = VALUE_SYNTH      ,
-  [ 'z' ]       = VALUE_MIDI       ,
-};
-
 #ifdef __EMSCRIPTEN__
 
 static U8 audio_thread_stack[AUDIO_THREAD_STACK] = {0};
@@ -235,20 +224,6 @@ static Void SDLCALL clavier_audio(
 
 #endif
 
-static ProgramHistory allocate_history(S32 length, V2S dimensions)
-{
-  ProgramHistory history;
-  history.dimensions = dimensions;
-  const S32 area = dimensions.x * dimensions.y;
-  history.register_file = SDL_calloc(length, sizeof(RegisterFile));
-  history.memory = SDL_calloc(length, area * sizeof(Value));
-  history.graph = SDL_calloc(length, GRAPH_FACTOR * area * sizeof(GraphEdge));
-  ASSERT(history.register_file);
-  ASSERT(history.memory);
-  ASSERT(history.graph);
-  return history;
-}
-
 static Void SDLCALL sample_chosen(Void* user_data, const Char* const* file_list, S32 filter)
 {
   UNUSED_PARAMETER(filter);
@@ -410,23 +385,58 @@ static Void SDL_SetRenderDrawColorStruct(SDL_Renderer* r, SDL_Color color)
   SDL_SetRenderDrawColor(r, color.r, color.g, color.b, color.a);
 }
 
-static Void input_value(V2S cursor, Value value)
+// the program as last published by the audio thread
+static Model displayed_model(Void)
+{
+  const Index cells = MODEL_CELLS(program_history.dimensions);
+  const Model model = {
+    .dimensions = program_history.dimensions,
+    .register_file = &program_history.register_file[render_index],
+    .memory = &program_history.memory[render_index * cells],
+  };
+  return model;
+}
+
+// send an edit of a rectangle of tiles, with room for undo to record them
+static Void edit(ControlMessage message, V2S origin, V2S size)
 {
-  const ControlMessage message = control_message_write(cursor, value);
+  if (undo_record(program_history.dimensions, origin, size, &message.undo) == false) {
+    SDL_Log("edit too large to undo, undo history cleared");
+  }
   ATOMIC_QUEUE_ENQUEUE(ControlMessage)(&control_queue, message);
 }
 
-static S32 character_literal(Char c)
+static Void undo(Void)
 {
-  if (c >= '0' && c <= '9') {
-    return c - '0';
-  } else if (c >= 'A' && c <= 'Z') {
-    return c - 'A' + 10;
-  } else {
-    return -1;
+  UndoStep step;
+  if (undo_back(&step)) {
+    ATOMIC_QUEUE_ENQUEUE(ControlMessage)(&control_queue, control_message_restore(step, false));
+  }
+}
+
+static Void redo(Void)
+{
+  UndoStep step;
+  if (undo_forward(&step)) {
+    ATOMIC_QUEUE_ENQUEUE(ControlMessage)(&control_queue, control_message_restore(step, true));
   }
 }
 
+// move the scrubbed beat, within what the tape holds
+static Void scrub(Index beats)
+{
+  const Index first = tape_first_frame(&tape);
+  const Index last = tape_last_frame(&tape);
+  if (first != INDEX_NONE) {
+    ui.scrub_frame = CLAMP(first, last, ui.scrub_frame + beats);
+  }
+}
+
+static Void input_value(V2S cursor, Value value)
+{
+  edit(control_message_write(cursor, value), cursor, v2s(1, 1));
+}
+
 static Void update_cursor(Direction d)
 {
   const V2S next = add_unit_vector(ui.cursor, d);
@@ -599,21 +609,43 @@ SDL_AppResult SDL_AppInit(Void** state, S32 argc, Char** argv)
 
   ATOMIC_QUEUE_INIT(Index)(&allocation_queue, allocation_queue_buffer, MESSAGE_QUEUE_CAPACITY);
   ATOMIC_QUEUE_INIT(Index)(&free_queue, free_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&profile_queue, profile_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&profile_free_queue, profile_free_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&dsp_queue, dsp_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&dsp_free_queue, dsp_free_queue_buffer, MESSAGE_QUEUE_CAPACITY);
   ATOMIC_QUEUE_INIT(ControlMessage)(&control_queue, control_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(ControlMessage)(&retire_queue, retire_queue_buffer, MESSAGE_QUEUE_CAPACITY);
 
   const V2S dimensions = { MODEL_DEFAULT_X, MODEL_DEFAULT_Y };
-  program_history = allocate_history(SIM_HISTORY, dimensions);
-  const ProgramHistory secondary = allocate_history(1, dimensions);
-  sim_init(program_history, secondary);
+  program_history = sim_allocate_history(SIM_HISTORY, dimensions, 0);
+  const ProgramHistory secondary = sim_allocate_secondary(dimensions);
+  tape = tape_allocate(dimensions);
 
   Model model = {
     .dimensions = program_history.dimensions,
     .register_file = program_history.register_file,
     .memory = program_history.memory,
+    .index = &program_history.index,
+    .program = &program_history.program,
   };
 
-  // initialize the model
+  // initialize the model, which sets the index strides the audio thread copies
   model_init(&model);
+  sim_init();
+
+  // the editor drives the first instance in the rack
+  const SimChannel channel = {
+    .allocation_queue = &allocation_queue,
+    .free_queue = &free_queue,
+    .profile_queue = &profile_queue,
+    .profile_free_queue = &profile_free_queue,
+    .dsp_queue = &dsp_queue,
+    .dsp_free_queue = &dsp_free_queue,
+    .control_queue = &control_queue,
+    .retire_queue = &retire_queue,
+    .dsp_history = dsp_history,
+  };
+  sim_attach(channel, program_history, secondary);
 
   // tell the render thread about the first slot
   ATOMIC_QUEUE_ENQUEUE(Index)(&allocation_queue, 0);
@@ -623,6 +655,16 @@ SDL_AppResult SDL_AppInit(Void** state, S32 argc, Char** argv)
     ATOMIC_QUEUE_ENQUEUE(Index)(&free_queue, i);
   }
 
+  // the render thread holds the first dsp state, like the first slot
+  for (Index i = 1; i < SIM_HISTORY; i++) {
+    ATOMIC_QUEUE_ENQUEUE(Index)(&dsp_free_queue, i);
+  }
+
+  // the audio thread accumulates into the first profile window
+  for (Index i = 1; i < SIM_PROFILES; i++) {
+    ATOMIC_QUEUE_ENQUEUE(Index)(&profile_free_queue, i);
+  }
+
 #ifdef __EMSCRIPTEN__
 
   EMSCRIPTEN_WEBAUDIO_T context = emscripten_create_audio_context(0);
@@ -652,20 +694,66 @@ SDL_AppResult SDL_AppInit(Void** state, S32 argc, Char** argv)
   return SDL_APP_CONTINUE;
 }
 
+// grow the render graph to hold at least `capacity` edges
+static Void reserve_render_graph(Index capacity)
+{
+  if (capacity > render_graph.capacity) {
+    SDL_free(render_graph.edges);
+    render_graph.capacity = capacity;
+    render_graph.head = 0;
+    render_graph.edges = SDL_calloc(capacity, sizeof(GraphEdge));
+    ASSERT(render_graph.edges);
+  }
+}
+
+static const Graph* derive_graph(const Model* model)
+{
+  // match the scratch buffer to the program size
+  if (v2s_equal(render_graph_dimensions, model->dimensions) == false) {
+    SDL_free(render_graph_scratch);
+    render_graph_scratch = SDL_calloc(MODEL_CELLS(model->dimensions), sizeof(Cell));
+    render_graph_dimensions = model->dimensions;
+    render_graph_source = NULL;
+    ASSERT(render_graph_scratch);
+  }
+
+  // published slots are never written, so the graph only changes with them
+  const Index frame = model->register_file->frame;
+  if (model->memory != render_graph_source || frame != render_graph_frame) {
+    // Edges follow the operators, not the area. Operators written during the
+    // beat may record more, so a full graph is grown and derived again.
+    reserve_render_graph(GRAPH_FACTOR * MAX(model_operators(model), 1));
+    model_graph(model, render_graph_scratch, &render_graph);
+    while (render_graph.head == render_graph.capacity) {
+      reserve_render_graph(2 * render_graph.capacity);
+      model_graph(model, render_graph_scratch, &render_graph);
+    }
+    render_graph_source = model->memory;
+    render_graph_frame = frame;
+  }
+
+  return &render_graph;
+}
+
 static Void compute_layout(DrawArena* draw, InteractionArena* interaction, V2F mouse)
 {
-  const Index area = program_history.dimensions.x * program_history.dimensions.y;
-  const Model model = {
-    .dimensions = program_history.dimensions,
-    .register_file = &program_history.register_file[render_index],
-    .memory = &program_history.memory[render_index * area],
-  };
+  // show a past beat from the tape while scrubbing
+  Model model = displayed_model();
+  if (ui.interaction == INTERACTION_SCRUB) {
+    scrub(0);
+    tape_read(&tape, ui.scrub_frame, &model);
+  }
 
   // get dsp pointer from index
-  const DSPState* const dsp = &dsp_history[render_index];
+  const DSPState* const dsp = &dsp_history[render_dsp];
+
+  // get profile pointer from index
+  const ModelProfile* const profile = render_profile != INDEX_NONE
+    ? &program_history.profiles[render_profile]
+    : NULL;
 
-  // get graph pointer from index
-  const GraphEdge* const graph = &program_history.graph[render_index * GRAPH_FACTOR * area];
+  // derive graph from the displayed program
+  const Graph* const graph = derive_graph(&model);
 
   const LayoutParameters layout_parameters = {
     .window = window_size,
@@ -675,6 +763,7 @@ static Void compute_layout(DrawArena* draw, InteractionArena* interaction, V2F m
     .model = &model,
     .graph = graph,
     .dsp = dsp,
+    .profile = profile,
     .metrics = &metrics,
   };
   layout(draw, interaction, &ui, &layout_parameters);
@@ -693,6 +782,8 @@ static SDL_AppResult event_handler(const SDL_Event* event)
 
   // shorthand
   const SDL_Keycode keycode = event->key.key;
+  const Bool command = (event->key.mod & (SDL_KMOD_CTRL | SDL_KMOD_GUI)) != 0;
+  const Bool shift = (event->key.mod & SDL_KMOD_SHIFT) != 0;
   
   // @rdk: unify with logic in layout
   const S32 tile_size = MAX(font_large.glyph.x, font_large.glyph.y);
@@ -758,7 +849,7 @@ static SDL_AppResult event_handler(const SDL_Event* event)
               while (*c) {
                 const S32 literal = character_literal(*c);
                 const Value value = {
-                  .tag = value_table[*c],
+                  .tag = character_tag(*c),
                   .powered = true,
                 };
                 if (value.tag != VALUE_NONE) {
@@ -787,7 +878,7 @@ static SDL_AppResult event_handler(const SDL_Event* event)
                   update_cursor(DIRECTION_SOUTH);
                   break;
                 case SDLK_RETURN:
-                  ATOMIC_QUEUE_ENQUEUE(ControlMessage)(&control_queue, control_message_power(ui.cursor));
+                  edit(control_message_power(ui.cursor), ui.cursor, v2s(1, 1));
                   break;
                 case SDLK_SPACE:
                   ATOMIC_QUEUE_ENQUEUE(ControlMessage)(
@@ -797,6 +888,27 @@ static SDL_AppResult event_handler(const SDL_Event* event)
                 case SDLK_BACKSPACE:
                   input_value(ui.cursor, value_none);
                   break;
+                case SDLK_F2:
+                  ui.heatmap = ! ui.heatmap;
+                  break;
+                case SDLK_F3:
+                  if (tape_last_frame(&tape) != INDEX_NONE) {
+                    ui.scrub_frame = tape_last_frame(&tape);
+                    ui.interaction = INTERACTION_SCRUB;
+                  }
+                  break;
+                case SDLK_Z:
+                  if (command && shift) {
+                    redo();
+                  } else if (command) {
+                    undo();
+                  }
+                  break;
+                case SDLK_Y:
+                  if (command) {
+                    redo();
+                  }
+                  break;
                 default: { }
               }
             } break;
@@ -936,9 +1048,20 @@ static SDL_AppResult event_handler(const SDL_Event* event)
                             } break;
                           case FILE_MENU_NEW:
                             {
-                              ATOMIC_QUEUE_ENQUEUE(ControlMessage)(
-                                  &control_queue,
-                                  control_message_generic(CONTROL_MESSAGE_CLEAR));
+                              edit(control_message_generic(CONTROL_MESSAGE_CLEAR), v2s(0, 0), program_history.dimensions);
+                            } break;
+                        }
+                      } break;
+                    case MENU_EDIT:
+                      {
+                        switch (hover->menu_item.item) {
+                          case EDIT_MENU_UNDO:
+                            {
+                              undo();
+                            } break;
+                          case EDIT_MENU_REDO:
+                            {
+                              redo();
                             } break;
                         }
                       } break;
@@ -962,6 +1085,38 @@ static SDL_AppResult event_handler(const SDL_Event* event)
         }
       } break;
 
+    case INTERACTION_SCRUB:
+      {
+        switch (event->type) {
+          case SDL_EVENT_KEY_DOWN:
+            {
+              switch (keycode) {
+                case SDLK_LEFT:
+                  scrub(shift ? -TAPE_KEYFRAME : -1);
+                  break;
+                case SDLK_RIGHT:
+                  scrub(shift ? TAPE_KEYFRAME : 1);
+                  break;
+                case SDLK_HOME:
+                  scrub(-tape_last_frame(&tape));
+                  break;
+                case SDLK_END:
+                  scrub(tape_last_frame(&tape));
+                  break;
+                case SDLK_ESCAPE:
+                case SDLK_F3:
+                  ui.interaction = INTERACTION_NONE;
+                  break;
+                default: { }
+              }
+            } break;
+          case SDL_EVENT_MOUSE_WHEEL:
+            {
+              scrub(event->wheel.y > 0.f ? -1 : 1);
+            } break;
+        }
+      } break;
+
     case INTERACTION_MEMORY_DIMENSIONS:
     case INTERACTION_TEMPO:
       {
@@ -995,10 +1150,15 @@ static SDL_AppResult event_handler(const SDL_Event* event)
                             const S32 y = SDL_atoi(ystr);
                             if (x > 0 && y > 0) {
                               const V2S dimensions = { x, y };
-                              program_history = allocate_history(SIM_HISTORY, dimensions);
-                              const ProgramHistory secondary = allocate_history(1, dimensions);
+                              const Model displayed = displayed_model();
+                              const Index operators = model_operators(&displayed);
+                              program_history = sim_allocate_history(SIM_HISTORY, dimensions, operators);
+                              tape_free(&tape);
+                              tape = tape_allocate(dimensions);
+                              const ProgramHistory secondary = sim_allocate_secondary(dimensions);
                               ui.cursor.x = MIN(ui.cursor.x, x - 1);
                               ui.cursor.y = MIN(ui.cursor.y, y - 1);
+                              undo_reset();
                               ATOMIC_QUEUE_ENQUEUE(ControlMessage)(
                                   &control_queue,
                                   control_message_memory_resize(program_history, secondary));
@@ -1150,12 +1310,68 @@ SDL_AppResult SDL_AppIterate(Void* state)
     ASSERT(allocation_message != sentinel);
     ATOMIC_QUEUE_ENQUEUE(Index)(&free_queue, render_index);
     render_index = allocation_message;
+
+    // record the beat, if the slot has a new one
+    const Model model = displayed_model();
+    tape_record(&tape, &model);
+  }
+
+  // free the histories replaced by a resize, and grow the program on request
+  while (ATOMIC_QUEUE_LENGTH(ControlMessage)(&retire_queue) > 0) {
+    ControlMessage sentinel = {0};
+    ControlMessage message = ATOMIC_QUEUE_DEQUEUE(ControlMessage)(&retire_queue, sentinel);
+    switch (message.tag) {
+      case CONTROL_MESSAGE_MEMORY_RESIZE:
+        {
+          sim_free_history(&message.resize.primary);
+          sim_free_history(&message.resize.secondary);
+        } break;
+      case CONTROL_MESSAGE_CAPACITY:
+        {
+          if (message.operators > program_history.program.capacity) {
+            // the displayed slot is ours, so it carries over until the next one
+            const Model displayed = displayed_model();
+            const V2S dimensions = program_history.dimensions;
+            program_history = sim_allocate_history(SIM_HISTORY, dimensions, message.operators);
+            const ProgramHistory secondary = sim_allocate_secondary(dimensions);
+            const Model model = displayed_model();
+            *model.register_file = *displayed.register_file;
+            SDL_memcpy(model.memory, displayed.memory, MODEL_CELLS(dimensions) * sizeof(Cell));
+            ATOMIC_QUEUE_ENQUEUE(ControlMessage)(
+                &control_queue,
+                control_message_memory_resize(program_history, secondary));
+          }
+        } break;
+      default: { }
+    }
+  }
+
+  // empty the dsp queue
+  while (ATOMIC_QUEUE_LENGTH(Index)(&dsp_queue) > 0) {
+    const Index sentinel = -1;
+    const Index dsp_message = ATOMIC_QUEUE_DEQUEUE(Index)(&dsp_queue, sentinel);
+    ASSERT(dsp_message != sentinel);
+    ATOMIC_QUEUE_ENQUEUE(Index)(&dsp_free_queue, render_dsp);
+    render_dsp = dsp_message;
+  }
+
+  // empty the profile queue
+  while (ATOMIC_QUEUE_LENGTH(Index)(&profile_queue) > 0) {
+    const Index sentinel = -1;
+    const Index profile_message = ATOMIC_QUEUE_DEQUEUE(Index)(&profile_queue, sentinel);
+    ASSERT(profile_message != sentinel);
+    if (render_profile != INDEX_NONE) {
+      ATOMIC_QUEUE_ENQUEUE(Index)(&profile_free_queue, render_profile);
+    }
+    render_profile = profile_message;
   }
 
   // update render metrics
   metrics.frame_time = (next_begin - frame_begin) * MEGA / frequency;
   metrics.frame_count = frame_count;
   metrics.render_index = render_index;
+  metrics.tape_beats = tape.count - tape.first;
+  metrics.tape_bytes = tape_bytes(&tape);
 
   // clear
   SDL_SetRenderDrawColorFloat(renderer, 0.1f, 0.1f, 0.1f, SDL_ALPHA_OPAQUE_FLOAT);
@@ -10,11 +10,17 @@
 
 ATOMIC_QUEUE_TYPE(Index) allocation_queue = {0};
 ATOMIC_QUEUE_TYPE(Index) free_queue = {0};
+ATOMIC_QUEUE_TYPE(Index) profile_queue = {0};
+ATOMIC_QUEUE_TYPE(Index) profile_free_queue = {0};
+ATOMIC_QUEUE_TYPE(Index) dsp_queue = {0};
+ATOMIC_QUEUE_TYPE(Index) dsp_free_queue = {0};
 ATOMIC_QUEUE_TYPE(ControlMessage) control_queue = {0};
+ATOMIC_QUEUE_TYPE(ControlMessage) retire_queue = {0};
 
 ControlMessage control_message_generic(ControlMessageTag tag)
 {
   ControlMessage message;
+  message.undo = (UndoStep) {0};
   message.tag = tag;
   return message;
 }
@@ -22,6 +28,7 @@ ControlMessage control_message_generic(ControlMessageTag tag)
 ControlMessage control_message_write(V2S point, Value value)
 {
   ControlMessage message;
+  message.undo = (UndoStep) {0};
   message.tag = CONTROL_MESSAGE_WRITE;
   message.write.point = point;
   message.write.value = value;
@@ -31,6 +38,7 @@ ControlMessage control_message_write(V2S point, Value value)
 ControlMessage control_message_power(V2S point)
 {
   ControlMessage message;
+  message.undo = (UndoStep) {0};
   message.tag = CONTROL_MESSAGE_POWER;
   message.power.point = point;
   return message;
@@ -62,6 +70,23 @@ ControlMessage control_message_memory_resize(ProgramHistory primary, ProgramHist
   return message;
 }
 
+ControlMessage control_message_restore(UndoStep step, Bool forward)
+{
+  ControlMessage message;
+  message.tag = CONTROL_MESSAGE_RESTORE;
+  message.restore.step = step;
+  message.restore.forward = forward;
+  return message;
+}
+
+ControlMessage control_message_capacity(Index operators)
+{
+  ControlMessage message;
+  message.tag = CONTROL_MESSAGE_CAPACITY;
+  message.operators = operators;
+  return message;
+}
+
 ControlMessage control_message_clear()
 {
   ControlMessage message;
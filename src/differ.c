@@ -0,0 +1,540 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model.h"
+
+// defaults, each of which can be overridden on the command line
+#define DIFFER_DEFAULT_SEED 1
+#define DIFFER_DEFAULT_TRIALS 200
+#define DIFFER_DEFAULT_BEATS 0x1000
+
+// limits on the random grids
+#define DIFFER_MIN_X 4
+#define DIFFER_MAX_X 32
+#define DIFFER_MIN_Y 4
+#define DIFFER_MAX_Y 24
+
+// events recorded by each engine on a single beat
+#define DIFFER_EVENTS 0x400
+
+#define EMPTY_CHARACTER '.'
+
+// The engines under test. The reference is `model_step` with no index and no
+// program, which visits every tile in reading order. The others each enable
+// one more layer of optimization, and the batch runs the grid in the first
+// variant of a lockstep batch.
+typedef enum Engine {
+  ENGINE_REFERENCE,
+  ENGINE_INDEXED,
+  ENGINE_COMPILED,
+  ENGINE_LANES,
+  ENGINE_BATCH,
+  ENGINE_CARDINAL,
+} Engine;
+
+static const Char* engine_table[ENGINE_CARDINAL] = {
+  [ ENGINE_REFERENCE  ] = "reference",
+  [ ENGINE_INDEXED    ] = "indexed",
+  [ ENGINE_COMPILED   ] = "compiled",
+  [ ENGINE_LANES      ] = "lanes",
+  [ ENGINE_BATCH      ] = "batch",
+};
+
+// the characters typed to enter each operator
+static const Char character_table[VALUE_CARDINAL] = {
+  [ VALUE_BANG          ] = '!',
+  [ VALUE_ADD           ] = '+',
+  [ VALUE_SUB           ] = '-',
+  [ VALUE_MUL           ] = '*',
+  [ VALUE_DIV           ] = '/',
+  [ VALUE_EQUAL         ] = '=',
+  [ VALUE_GREATER       ] = '>',
+  [ VALUE_LESSER        ] = '<',
+  [ VALUE_AND           ] = '&',
+  [ VALUE_OR            ] = '|',
+  [ VALUE_ALTER         ] = 'a',
+  [ VALUE_BOTTOM        ] = 'b',
+  [ VALUE_CLOCK         ] = 'c',
+  [ VALUE_DELAY         ] = 'd',
+  [ VALUE_HOP           ] = 'h',
+  [ VALUE_INTERFERE     ] = 'i',
+  [ VALUE_JUMP          ] = 'j',
+  [ VALUE_LOAD          ] = 'l',
+  [ VALUE_MULTIPLEX     ] = 'm',
+  [ VALUE_NOTE          ] = 'n',
+  [ VALUE_ODDMENT       ] = 'o',
+  [ VALUE_QUOTE         ] = 'q',
+  [ VALUE_RANDOM        ] = 'r',
+  [ VALUE_STORE         ] = 's',
+  [ VALUE_TOP           ] = 't',
+  [ VALUE_WAVE          ] = 'w',
+  [ VALUE_SAMPLER       ] = 'x',
+  [ VALUE_SYNTH         ] = 'y',
+  [ VALUE_MIDI          ] = 'z',
+};
+
+// One engine and the memory it owns. Each instance steps its own copy of the
+// grid, so that the only thing they share is the starting state.
+typedef struct Instance {
+  RegisterFile register_file;
+  Cell* memory;
+  ModelIndex index;
+  ModelProgram program;
+  Index frame_period;
+  ModelEvent events[DIFFER_EVENTS];
+  EventSink sink;
+  Model model;
+  ModelBatch batch;                       // for ENGINE_BATCH
+  Bool batched;                           // whether the batch took the grid
+  EventSink variant_sinks[MODEL_BATCH];
+} Instance;
+
+// the first difference found between the reference and another engine
+typedef struct Divergence {
+  Engine engine;
+  Index beat;
+  Char what[0x100];
+} Divergence;
+
+// Runs the lanes one after another, last first. The lanes of a program are
+// independent, so any order gives the same result, and running them out of
+// reading order makes a partition that is not independent show up here
+// rather than as a rare race on the audio thread.
+static Void differ_run(Void* context, Void (*task)(Void* arg, Index lane), Void* arg, Index count)
+{
+  UNUSED_PARAMETER(context);
+  for (Index lane = count - 1; lane >= 0; lane--) {
+    task(arg, lane);
+  }
+}
+
+static const ModelPool differ_pool = { .context = NULL, .run = differ_run };
+
+static Void* differ_calloc(Index count, Index size)
+{
+  Void* const p = calloc((size_t) MAX(count, 1), (size_t) size);
+  if (p == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+static Void instance_init(Instance* instance, Engine engine, V2S dimensions)
+{
+  const Index area = dimensions.x * dimensions.y;
+  const Index words = model_index_words(dimensions);
+
+  memset(instance, 0, sizeof(*instance));
+  instance->memory = differ_calloc(MODEL_CELLS(dimensions), sizeof(Cell));
+  instance->index.active = differ_calloc(words, sizeof(U64));
+  instance->index.bangs = differ_calloc(words, sizeof(U64));
+  instance->index.adjacent = differ_calloc(words, sizeof(U64));
+  instance->index.chunks = differ_calloc(model_chunk_words(dimensions), sizeof(U64));
+  instance->program.capacity = area;
+  instance->program.instructions = differ_calloc(area, sizeof(Instruction));
+  instance->program.cursor = INDEX_NONE;
+  instance->program.pending = differ_calloc(area, sizeof(Index));
+  instance->program.partition = differ_calloc(words + area, sizeof(Index));
+  instance->batch.memory = differ_calloc(MODEL_BATCH_CELLS(dimensions), sizeof(Cell));
+  instance->batch.stream = differ_calloc(MODEL_BATCH_STREAM(dimensions), sizeof(Instruction));
+  instance->frame_period = 1;
+  instance->sink.capacity = DIFFER_EVENTS;
+  instance->sink.events = instance->events;
+
+  instance->model = (Model) {
+    .dimensions = dimensions,
+    .register_file = &instance->register_file,
+    .memory = instance->memory,
+    .index = engine >= ENGINE_INDEXED && engine != ENGINE_BATCH ? &instance->index : NULL,
+    .program = engine >= ENGINE_COMPILED && engine != ENGINE_BATCH ? &instance->program : NULL,
+    .frame_period = &instance->frame_period,
+    .pool = engine == ENGINE_LANES ? &differ_pool : NULL,
+  };
+
+  model_init(&instance->model);
+}
+
+static Void instance_free(Instance* instance)
+{
+  free(instance->memory);
+  free(instance->index.active);
+  free(instance->index.bangs);
+  free(instance->index.adjacent);
+  free(instance->index.chunks);
+  free(instance->program.instructions);
+  free(instance->program.pending);
+  free(instance->program.partition);
+  free(instance->batch.memory);
+  free(instance->batch.stream);
+}
+
+// A tile of another variant in a batch, with different data and power but
+// the same operators. The choice depends only on the tile, so that shrinking a
+// grid shrinks its variants with it.
+static Cell variant_cell(Cell cell, Index tile, Index variant)
+{
+  U32 h = (U32) tile * 0x9E3779B1u ^ (U32) variant * 0x85EBCA77u;
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  if (cell_tag(cell) > VALUE_BANG) {
+    return h % 4 == 0 ? cell ^ CELL_POWERED : cell;
+  }
+  switch (h % 4) {
+    case 0:
+    case 1:
+      return cell;
+    case 2:
+      return cell_of_value(value_literal((S32) (h >> 8) % MODEL_RADIX));
+    default:
+      return 0;
+  }
+}
+
+// Load the grid as the first variant of the instance's batch, and variants of
+// it as the rest, each with its own random state.
+static Void batch_load(Instance* instance, V2S dimensions, const Cell* grid)
+{
+  const Index cells = MODEL_CELLS(dimensions);
+  Cell* const memory = differ_calloc(MODEL_BATCH * cells, sizeof(Cell));
+  RegisterFile register_files[MODEL_BATCH];
+  Model variants[MODEL_BATCH];
+  variants[0] = instance->model;
+  for (Index v = 1; v < MODEL_BATCH; v++) {
+    variants[v] = (Model) {
+      .dimensions = dimensions,
+      .register_file = &register_files[v],
+      .memory = &memory[v * cells],
+    };
+    model_init(&variants[v]);
+    rnd_pcg_seed(&register_files[v].rnd, (U32) v);
+    for (S32 y = 0; y < dimensions.y; y++) {
+      for (S32 x = 0; x < dimensions.x; x++) {
+        const Index tile = y * dimensions.x + x;
+        model_set(&variants[v], v2s(x, y), value_of_cell(variant_cell(grid[tile], tile, v)));
+      }
+    }
+  }
+  instance->batched = model_batch_load(&instance->batch, variants, MODEL_BATCH);
+  free(memory);
+}
+
+// Clear the operators that stop a grid from running in a batch. Almost every
+// random grid has one, so the batch engine only gets grids cleared this way.
+static Void batch_prepare(V2S dimensions, Cell* grid)
+{
+  RegisterFile register_file;
+  Cell* const memory = differ_calloc(MODEL_CELLS(dimensions), sizeof(Cell));
+  Model m = {
+    .dimensions = dimensions,
+    .register_file = &register_file,
+    .memory = memory,
+  };
+  model_init(&m);
+  for (S32 y = 0; y < dimensions.y; y++) {
+    for (S32 x = 0; x < dimensions.x; x++) {
+      model_set(&m, v2s(x, y), value_of_cell(grid[y * dimensions.x + x]));
+    }
+  }
+  for (Index i = model_batch_conflict(&m); i != INDEX_NONE; i = model_batch_conflict(&m)) {
+    const V2S point = model_point(dimensions, i);
+    grid[point.y * dimensions.x + point.x] = 0;
+    model_set(&m, point, value_none);
+  }
+  free(memory);
+}
+
+static Value random_value(rnd_pcg_t* rnd)
+{
+  const S32 roll = rnd_pcg_range(rnd, 0, 99);
+  if (roll < 60) {
+    return value_none;
+  } else if (roll < 75) {
+    return value_literal(rnd_pcg_range(rnd, 0, MODEL_RADIX - 1));
+  } else if (roll < 80) {
+    return value_bang;
+  } else {
+    // skip the letters with no operator
+    ValueTag tag = VALUE_NONE;
+    while (character_table[tag] == 0 || tag == VALUE_BANG) {
+      tag = (ValueTag) rnd_pcg_range(rnd, VALUE_ADD, VALUE_CARDINAL - 1);
+    }
+    return (Value) {
+      .tag = tag,
+      .powered = rnd_pcg_range(rnd, 0, 3) != 0,
+    };
+  }
+}
+
+static Char value_character(Value value)
+{
+  if (value.tag == VALUE_NONE) {
+    return EMPTY_CHARACTER;
+  } else if (value.tag == VALUE_LITERAL) {
+    return (Char) (value.literal < 10 ? '0' + value.literal : 'A' + value.literal - 10);
+  } else {
+    return character_table[value.tag];
+  }
+}
+
+static Void print_grid(V2S dimensions, const Cell* grid)
+{
+  printf("%dx%d grid:\n", dimensions.x, dimensions.y);
+  for (S32 y = 0; y < dimensions.y; y++) {
+    printf("  ");
+    for (S32 x = 0; x < dimensions.x; x++) {
+      putchar(value_character(value_of_cell(grid[y * dimensions.x + x])));
+    }
+    putchar('\n');
+  }
+
+  // the typed form has no way to write an unpowered operator
+  for (S32 y = 0; y < dimensions.y; y++) {
+    for (S32 x = 0; x < dimensions.x; x++) {
+      const Value value = value_of_cell(grid[y * dimensions.x + x]);
+      if (value.tag >= VALUE_BANG && value.powered == false) {
+        printf("  unpowered: %d %d\n", x, y);
+      }
+    }
+  }
+}
+
+static Bool compare_events(const EventSink* a, const EventSink* b, Char* what, size_t what_bytes)
+{
+  if (a->head != b->head || a->dropped != b->dropped) {
+    snprintf(what, what_bytes, "event count %td (+%td dropped) vs %td (+%td dropped)",
+        a->head, a->dropped, b->head, b->dropped);
+    return false;
+  }
+
+  for (Index i = 0; i < a->head; i++) {
+    const ModelEvent* const p = &a->events[i];
+    const ModelEvent* const q = &b->events[i];
+    const Bool same =
+      p->frame == q->frame &&
+      v2s_equal(p->origin, q->origin) &&
+      p->tag == q->tag &&
+      memcmp(p->operands, q->operands, sizeof(p->operands)) == 0;
+    if (same == false) {
+      snprintf(what, what_bytes, "event %td: %c at %d %d vs %c at %d %d",
+          i,
+          character_table[p->tag], p->origin.x, p->origin.y,
+          character_table[q->tag], q->origin.x, q->origin.y);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Only the reference marks pulse on inactive tiles, as described in model.h,
+// so a tile or register is compared without it there.
+static Cell comparable(Cell cell)
+{
+  return cell_tag(cell) < VALUE_BANG ? cell & ~CELL_PULSE : cell;
+}
+
+// the reference's hash, as if it had left pulse off inactive tiles
+static U64 comparable_hash(const Instance* reference)
+{
+  const V2S d = reference->model.dimensions;
+  RegisterFile rf = reference->register_file;
+  Cell* const memory = differ_calloc(MODEL_CELLS(d), sizeof(Cell));
+  for (Index r = 0; r < MODEL_RADIX; r++) {
+    rf.registers[r] = comparable(rf.registers[r]);
+  }
+  for (Index i = 0; i < MODEL_CELLS(d); i++) {
+    memory[i] = comparable(reference->memory[i]);
+  }
+  const Model model = { .dimensions = d, .register_file = &rf, .memory = memory };
+  const U64 hash = model_hash(&model);
+  free(memory);
+  return hash;
+}
+
+// compare an engine against the reference after a beat
+static Bool compare(const Instance* reference, const Instance* other, Char* what, size_t what_bytes)
+{
+  const V2S d = reference->model.dimensions;
+  const RegisterFile* const a = &reference->register_file;
+  const RegisterFile* const b = &other->register_file;
+
+  for (Index i = 0; i < MODEL_CELLS(d); i++) {
+    if (comparable(reference->memory[i]) != other->memory[i]) {
+      const V2S point = model_point(d, i);
+      const Value p = value_of_cell(reference->memory[i]);
+      const Value q = value_of_cell(other->memory[i]);
+      snprintf(what, what_bytes, "tile %d %d: %c%s%s vs %c%s%s",
+          point.x, point.y,
+          value_character(p), p.powered ? " powered" : "", p.pulse ? " pulse" : "",
+          value_character(q), q.powered ? " powered" : "", q.pulse ? " pulse" : "");
+      return false;
+    }
+  }
+
+  if (a->frame != b->frame) {
+    snprintf(what, what_bytes, "frame %td vs %td", a->frame, b->frame);
+    return false;
+  }
+
+  for (Index r = 0; r < MODEL_RADIX; r++) {
+    if (comparable(a->registers[r]) != b->registers[r]) {
+      snprintf(what, what_bytes, "register %td: %d vs %d",
+          r, cell_literal(a->registers[r]), cell_literal(b->registers[r]));
+      return false;
+    }
+  }
+
+  if (memcmp(&a->rnd, &b->rnd, sizeof(a->rnd)) != 0) {
+    snprintf(what, what_bytes, "random number generator state");
+    return false;
+  }
+
+  const U64 hash = comparable_hash(reference);
+  if (hash != b->hash) {
+    snprintf(what, what_bytes, "hash %016llx vs %016llx",
+        (unsigned long long) hash, (unsigned long long) b->hash);
+    return false;
+  }
+
+  if (b->hash != model_hash(&other->model)) {
+    snprintf(what, what_bytes, "stale hash");
+    return false;
+  }
+
+  // a batch does not track the frame period
+  if (other->batched == false && reference->frame_period != other->frame_period) {
+    snprintf(what, what_bytes, "frame period %td vs %td",
+        reference->frame_period, other->frame_period);
+    return false;
+  }
+
+  return compare_events(&reference->sink, &other->sink, what, what_bytes);
+}
+
+// Step every engine from the grid for up to `beats` beats, and report the
+// first beat on which one of them parts from the reference.
+static Bool diverges(V2S dimensions, const Cell* grid, Index beats, Divergence* divergence)
+{
+  Instance* const instances = differ_calloc(ENGINE_CARDINAL, sizeof(Instance));
+  for (Engine e = 0; e < ENGINE_CARDINAL; e++) {
+    instance_init(&instances[e], e, dimensions);
+    for (S32 y = 0; y < dimensions.y; y++) {
+      for (S32 x = 0; x < dimensions.x; x++) {
+        model_set(&instances[e].model, v2s(x, y), value_of_cell(grid[y * dimensions.x + x]));
+      }
+    }
+  }
+  batch_load(&instances[ENGINE_BATCH], dimensions, grid);
+
+  Bool result = false;
+  for (Index beat = 0; beat < beats && result == false; beat++) {
+    for (Engine e = 0; e < ENGINE_CARDINAL; e++) {
+      Instance* const instance = &instances[e];
+      instance->sink.head = 0;
+      instance->sink.dropped = 0;
+      if (e != ENGINE_BATCH) {
+        model_step(&instance->model, NULL, &instance->sink);
+      } else if (instance->batched) {
+        // the other variants keep no events
+        instance->variant_sinks[0] = instance->sink;
+        for (Index v = 1; v < MODEL_BATCH; v++) {
+          instance->variant_sinks[v] = (EventSink) {0};
+        }
+        model_batch_step(&instance->batch, instance->variant_sinks);
+        model_batch_store(&instance->batch, 0, &instance->model);
+        instance->sink = instance->variant_sinks[0];
+      }
+    }
+    for (Engine e = ENGINE_INDEXED; e < ENGINE_CARDINAL && result == false; e++) {
+      if (e == ENGINE_BATCH && instances[e].batched == false) {
+        continue;
+      }
+      if (compare(&instances[ENGINE_REFERENCE], &instances[e], divergence->what, sizeof(divergence->what)) == false) {
+        divergence->engine = e;
+        divergence->beat = beat;
+        result = true;
+      }
+    }
+  }
+
+  for (Engine e = 0; e < ENGINE_CARDINAL; e++) {
+    instance_free(&instances[e]);
+  }
+  free(instances);
+  return result;
+}
+
+// Clear tiles one at a time for as long as the engines still part, until no
+// single tile can be removed.
+static Void shrink(V2S dimensions, Cell* grid, Divergence* divergence)
+{
+  const Index area = dimensions.x * dimensions.y;
+  Bool progress = true;
+  while (progress) {
+    progress = false;
+    for (Index i = 0; i < area; i++) {
+      if (grid[i] == 0) {
+        continue;
+      }
+      const Cell cell = grid[i];
+      grid[i] = 0;
+      Divergence candidate;
+      if (diverges(dimensions, grid, divergence->beat + 1, &candidate)) {
+        *divergence = candidate;
+        progress = true;
+      } else {
+        grid[i] = cell;
+      }
+    }
+  }
+}
+
+static Index parse_argument(Char** argv, S32 argc, S32 i, Index fallback)
+{
+  return i < argc ? (Index) strtoll(argv[i], NULL, 0) : fallback;
+}
+
+int main(int argc, char** argv)
+{
+  const Index seed = parse_argument(argv, argc, 1, DIFFER_DEFAULT_SEED);
+  const Index trials = parse_argument(argv, argc, 2, DIFFER_DEFAULT_TRIALS);
+  const Index beats = parse_argument(argv, argc, 3, DIFFER_DEFAULT_BEATS);
+
+  rnd_pcg_t rnd;
+  rnd_pcg_seed(&rnd, (U32) seed);
+
+  for (Index trial = 0; trial < trials; trial++) {
+
+    const V2S dimensions = {
+      rnd_pcg_range(&rnd, DIFFER_MIN_X, DIFFER_MAX_X),
+      rnd_pcg_range(&rnd, DIFFER_MIN_Y, DIFFER_MAX_Y),
+    };
+    const Index area = dimensions.x * dimensions.y;
+    Cell* const grid = differ_calloc(area, sizeof(Cell));
+    for (Index i = 0; i < area; i++) {
+      grid[i] = cell_of_value(random_value(&rnd));
+    }
+    if (trial % 2 == 1) {
+      batch_prepare(dimensions, grid);
+    }
+
+    Divergence divergence;
+    if (diverges(dimensions, grid, beats, &divergence)) {
+      printf("trial %td of seed %td: %s engine diverged on beat %td\n",
+          trial, seed, engine_table[divergence.engine], divergence.beat);
+      shrink(dimensions, grid, &divergence);
+      printf("minimal counterexample, %s engine on beat %td: %s\n",
+          engine_table[divergence.engine], divergence.beat, divergence.what);
+      print_grid(dimensions, grid);
+      free(grid);
+      return EXIT_FAILURE;
+    }
+
+    free(grid);
+  }
+
+  printf("%td trials of %td beats, no divergence\n", trials, beats);
+  return EXIT_SUCCESS;
+}
@@ -8,6 +8,9 @@
 
 #define MEMORY_CHARACTERS 16
 
+// entries in each ranking of the profile panel
+#define PROFILE_ROWS 5
+
 typedef struct UIContext {
   V2F origin;
   V2S bounds;
@@ -33,6 +36,7 @@ static const SDL_Color color_input        = COLOR_STRUCTURE(0x60, 0x70, 0x80, 0x
 static const SDL_Color color_sample_slot  = COLOR_STRUCTURE(0x40, 0x40, 0x40, 0xFF);
 static const SDL_Color color_dialog       = COLOR_STRUCTURE(0xFF, 0xFF, 0xFF, 0x40);
 static const SDL_Color color_menu_highlight = COLOR_STRUCTURE(0x2A, 0x88, 0xAD, 0xFF);
+static const SDL_Color color_heat         = COLOR_STRUCTURE(0xFF, 0x50, 0x20, 0xC0);
 
 static Void reset_ui_context(UIContext* context, V2F origin, V2S bounds)
 {
@@ -63,6 +67,8 @@ static const Char* edit_menu_table[EDIT_MENU_CARDINAL] = {
   [ EDIT_MENU_CUT ] = "Cut",
   [ EDIT_MENU_COPY ] = "Copy",
   [ EDIT_MENU_PASTE ] = "Paste",
+  [ EDIT_MENU_UNDO ] = "Undo",
+  [ EDIT_MENU_REDO ] = "Redo",
 };
 
 static const Char* help_menu_table[HELP_MENU_CARDINAL] = {
@@ -102,6 +108,7 @@ static Char representation_table[VALUE_CARDINAL] = {
   [ VALUE_RANDOM        ] = 'R',
   [ VALUE_STORE         ] = 'S',
   [ VALUE_TOP           ] = 'T',
+  [ VALUE_WAVE          ] = 'W',
   [ VALUE_SAMPLER       ] = 'X',
   [ VALUE_SYNTH         ] = 'Y',
   [ VALUE_MIDI          ] = 'Z',
@@ -142,7 +149,7 @@ static const Char* noun_table[VALUE_CARDINAL] = {
   [ VALUE_TOP       ] = "MAXIMIZER",
   [ VALUE_U         ] = "U",
   [ VALUE_V         ] = "V",
-  [ VALUE_W         ] = "W",
+  [ VALUE_WAVE      ] = "WAVETABLE",
   [ VALUE_SAMPLER   ] = "SAMPLER",
   [ VALUE_SYNTH     ] = "SYNTHESIZER",
   [ VALUE_MIDI      ] = "MIDI",
@@ -209,7 +216,8 @@ static const Char* description_table[VALUE_CARDINAL] = {
     "Selects the greater of " ATTRIBUTE_LEFT_COMPARATE " and " ATTRIBUTE_RIGHT_COMPARATE ".",
   [ VALUE_U         ] = "U",
   [ VALUE_V         ] = "V",
-  [ VALUE_W         ] = "W",
+  [ VALUE_WAVE      ] =
+    "A synthesizer playing " ATTRIBUTE_WAVEFORM " 0 to 3: sine, triangle, saw or square.",
   [ VALUE_SAMPLER   ] = "A simple sampler.",
   [ VALUE_SYNTH     ] = "A simple sine wave synthesizer.",
   [ VALUE_MIDI      ] = "Sends MIDI.",
@@ -383,6 +391,39 @@ static Void draw_text(DrawArena* draw, UIContext* context, const Char* text, V2S
   }
 }
 
+// Timed profiles rank by time, and the rest by the number of operations.
+static U64 profile_cost(const ProfileCounter* counter, Bool timed)
+{
+  return timed ? counter->ticks : (U64) counter->fires + counter->reads + counter->writes;
+}
+
+// keep the costliest entries seen so far, most costly first
+static Void profile_rank(Index* ranks, U64* costs, Index entry, U64 cost)
+{
+  if (cost == 0 || cost <= costs[PROFILE_ROWS - 1]) {
+    return;
+  }
+  Index i = PROFILE_ROWS - 1;
+  while (i > 0 && costs[i - 1] < cost) {
+    ranks[i] = ranks[i - 1];
+    costs[i] = costs[i - 1];
+    i -= 1;
+  }
+  ranks[i] = entry;
+  costs[i] = cost;
+}
+
+// the cost of an entry per beat, in microseconds if timed
+static F64 profile_rate(const ModelProfile* profile, U64 cost)
+{
+  const F64 beats = (F64) MAX(profile->beats, 1);
+  if (profile->clock && profile->frequency > 0) {
+    return (F64) cost * MEGA / (F64) profile->frequency / beats;
+  } else {
+    return (F64) cost / beats;
+  }
+}
+
 static Void draw_text_line(DrawArena* draw, V2F origin, V2S glyph, const Char* text)
 {
   UIContext context;
@@ -399,10 +440,11 @@ Void layout(
     const LayoutParameters* parameters)
 {
   // shorthand
-  const GraphEdge* const graph = parameters->graph;
+  const Graph* const graph = parameters->graph;
   const Model* const model = parameters->model;
   const RenderMetrics* const metrics = parameters->metrics;
   const DSPState* const dsp = parameters->dsp;
+  const ModelProfile* const profile = ui->heatmap ? parameters->profile : NULL;
   const V2S font_small = parameters->font_small;
   const V2S font_large = parameters->font_large;
   const V2S window = parameters->window;
@@ -431,28 +473,49 @@ Void layout(
     .name = TEXTURE_WHITE,
   };
 
-  const Index graph_size = GRAPH_FACTOR * model->dimensions.x * model->dimensions.y;
   const V2S map_pixels = {
     window.x - 2 * panel_width,
     window.y - 2 * menu_height,
   };
 
   // draw graph highlights
-  for (Index i = 0; i < graph_size; i++) {
-    const GraphEdge edge = graph[i];
-    if (edge.tag == GRAPH_EDGE_INPUT) {
-      const R2F area = map_tile(camera, ui->zoom, tile_size, map_origin, map_pixels, edge.target);
+  for (Index i = 0; i < graph->head; i++) {
+    const GraphEdge edge = graph->edges[i];
+    if (graph_edge_tag(edge) == GRAPH_EDGE_INPUT) {
+      const R2F area = map_tile(camera, ui->zoom, tile_size, map_origin, map_pixels, graph_edge_target(edge));
       write_draw_rectangle(
           draw,
           draw_rectangle(area, color_input, white));
     }
   }
 
+  // draw evaluation heatmap, relative to the costliest tile
+  if (profile) {
+    const Bool timed = profile->clock != NULL;
+    U64 peak = 0;
+    for (Index i = 0; i < profile->capacity; i++) {
+      if (profile->tiles[i] != INDEX_NONE) {
+        peak = MAX(peak, profile_cost(&profile->cells[i], timed));
+      }
+    }
+    for (Index i = 0; i < profile->capacity && peak > 0; i++) {
+      const Index tile = profile->tiles[i];
+      const U64 cost = tile != INDEX_NONE ? profile_cost(&profile->cells[i], timed) : 0;
+      if (cost > 0) {
+        const V2S point = { (S32) (tile % model->dimensions.x), (S32) (tile / model->dimensions.x) };
+        const R2F area = map_tile(camera, ui->zoom, tile_size, map_origin, map_pixels, point);
+        SDL_Color color = color_heat;
+        color.a = (U8) (0x20 + (color_heat.a - 0x20) * cost / peak);
+        write_draw_rectangle(draw, draw_rectangle(area, color, white));
+      }
+    }
+  }
+
   // draw model
   for (S32 y = 0; y < model->dimensions.y; y++) {
     for (S32 x = 0; x < model->dimensions.x; x++) {
 
-      const Value value = MODEL_INDEX(model, x, y);
+      const Value value = value_of_cell(MODEL_INDEX(model, x, y));
       const Char tag_character = representation_table[value.tag];
       const R2F area = map_tile(camera, ui->zoom, tile_size, map_origin, map_pixels, v2s(x, y));
       const F32 padding = (tile_size - ui->zoom * font_large.x) / 2.f; // assumes font is taller than wide
@@ -462,7 +525,7 @@ Void layout(
       };
 
       if (value.tag == VALUE_LITERAL) {
-        const S32 literal = MODEL_INDEX(model, x, y).literal;
+        const S32 literal = value.literal;
         const Char c = literal >= 10
           ? 'A' + (Char) literal - 10
           : '0' + (Char) literal;
@@ -548,21 +611,19 @@ Void layout(
   }
 
   // draw voice playheads
-  for (Index i = 0; i < SIM_VOICES; i++) {
+  for (Index i = 0; i < dsp->voice_count; i++) {
     const DSPSamplerVoice* const voice = &dsp->voices[i];
-    if (voice->active) {
-      const F32 proportion = voice->frame / voice->length;
-      const R2F area = {
-        .origin = {
-          .x = proportion * panel_width,
-          .y = (F32) (sample_stride * voice->sound + menu_height - scroll + 1),
-        },
-        .size = { 3.f, (F32) (sample_height) },
-      };
-      write_draw_rectangle(
-          draw,
-          draw_rectangle(area, color_white, white));
-    }
+    const F32 proportion = voice->frame / voice->length;
+    const R2F area = {
+      .origin = {
+        .x = proportion * panel_width,
+        .y = (F32) (sample_stride * voice->sound + menu_height - scroll + 1),
+      },
+      .size = { 3.f, (F32) (sample_height) },
+    };
+    write_draw_rectangle(
+        draw,
+        draw_rectangle(area, color_white, white));
   }
 
   const R2F right_panel = {
@@ -611,10 +672,10 @@ Void layout(
 
   // draw input edges
   Index inputs = 0;
-  for (Index i = 0; i < graph_size; i++) {
-    const GraphEdge edge = graph[i];
-    if (edge.tag == GRAPH_EDGE_INPUT && v2s_equal(edge.target, ui->cursor)) {
-      SDL_snprintf(buffer, LAYOUT_PANEL_CHARACTERS, "%s for %s\n", edge.attribute, noun_table[edge.cause]);
+  for (Index i = 0; i < graph->head; i++) {
+    const GraphEdge edge = graph->edges[i];
+    if (graph_edge_tag(edge) == GRAPH_EDGE_INPUT && v2s_equal(graph_edge_target(edge), ui->cursor)) {
+      SDL_snprintf(buffer, LAYOUT_PANEL_CHARACTERS, "%s for %s\n", graph_attribute_table[edge.attribute], noun_table[edge.cause]);
       draw_text(draw, &context, buffer, font_small);
     }
   }
@@ -624,6 +685,55 @@ Void layout(
     draw_text(draw, &context, "\n", font_small);
   }
 
+  // draw the costliest operators and tiles
+  if (profile) {
+    const Bool timed = profile->clock != NULL;
+
+    Index tag_ranks[PROFILE_ROWS] = {0};
+    U64 tag_costs[PROFILE_ROWS] = {0};
+    for (Index t = 0; t < VALUE_CARDINAL; t++) {
+      profile_rank(tag_ranks, tag_costs, t, profile_cost(&profile->tags[t], timed));
+    }
+
+    Index tile_ranks[PROFILE_ROWS] = {0};
+    U64 tile_costs[PROFILE_ROWS] = {0};
+    for (Index i = 0; i < profile->capacity; i++) {
+      if (profile->tiles[i] != INDEX_NONE) {
+        profile_rank(tile_ranks, tile_costs, profile->tiles[i], profile_cost(&profile->cells[i], timed));
+      }
+    }
+
+    SDL_snprintf(
+        buffer,
+        LAYOUT_PANEL_CHARACTERS,
+        "PROFILE, %s PER BEAT\n",
+        timed ? "MICROSECONDS" : "OPERATIONS");
+    draw_text(draw, &context, buffer, font_small);
+    for (Index i = 0; i < PROFILE_ROWS && tag_costs[i] > 0; i++) {
+      SDL_snprintf(
+          buffer,
+          LAYOUT_PANEL_CHARACTERS,
+          "%-16s %8.1f\n",
+          noun_table[tag_ranks[i]],
+          profile_rate(profile, tag_costs[i]));
+      draw_text(draw, &context, buffer, font_small);
+    }
+    draw_text(draw, &context, "\n", font_small);
+    for (Index i = 0; i < PROFILE_ROWS && tile_costs[i] > 0; i++) {
+      const S32 x = (S32) (tile_ranks[i] % model->dimensions.x);
+      const S32 y = (S32) (tile_ranks[i] / model->dimensions.x);
+      SDL_snprintf(
+          buffer,
+          LAYOUT_PANEL_CHARACTERS,
+          "%dx%d %8.1f\n",
+          x,
+          y,
+          profile_rate(profile, tile_costs[i]));
+      draw_text(draw, &context, buffer, font_small);
+    }
+    draw_text(draw, &context, "\n", font_small);
+  }
+
   // draw bottom panel background
   {
     const R2F menu_panel = {
@@ -810,6 +920,17 @@ Void layout(
   draw_text(draw, &context, buffer, font_small);
   SDL_snprintf(buffer, LAYOUT_PANEL_CHARACTERS, "history index: %03td\n", metrics->render_index);
   draw_text(draw, &context, buffer, font_small);
+  SDL_snprintf(
+      buffer,
+      LAYOUT_PANEL_CHARACTERS,
+      "tape: %td beats, %td KB\n",
+      metrics->tape_beats,
+      metrics->tape_bytes / 1024);
+  draw_text(draw, &context, buffer, font_small);
+  if (ui->interaction == INTERACTION_SCRUB) {
+    SDL_snprintf(buffer, LAYOUT_PANEL_CHARACTERS, "scrubbing beat %td\n", model->register_file->frame);
+    draw_text(draw, &context, buffer, font_small);
+  }
 
   // draw map interaction
   write_interaction_rectangle(
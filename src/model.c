@@ -1,13 +1,8 @@
+#include <limits.h>
 #include <string.h>
 #include <SDL3/SDL_log.h>
 #include "model.h"
 
-typedef struct Graph {
-  Index capacity;
-  Index head;
-  GraphEdge* edges;
-} Graph;
-
 _Static_assert(
     sizeof(MODEL_SIGNATURE) == MODEL_SIGNATURE_BYTES + 1,
     "invalid signature size"
@@ -20,6 +15,92 @@ static V2S unit_vector_table[DIRECTION_CARDINAL] = {
   [ DIRECTION_WEST        ] = { -1,  0 },
 };
 
+const Char* const graph_attribute_table[GRAPH_ATTRIBUTE_CARDINAL] = {
+  [ GRAPH_ATTRIBUTE_NONE            ] = "",
+  [ GRAPH_ATTRIBUTE_LEFT_ADDEND     ] = ATTRIBUTE_LEFT_ADDEND,
+  [ GRAPH_ATTRIBUTE_RIGHT_ADDEND    ] = ATTRIBUTE_RIGHT_ADDEND,
+  [ GRAPH_ATTRIBUTE_MINUEND         ] = ATTRIBUTE_MINUEND,
+  [ GRAPH_ATTRIBUTE_SUBTRAHEND      ] = ATTRIBUTE_SUBTRAHEND,
+  [ GRAPH_ATTRIBUTE_MULTIPLIER      ] = ATTRIBUTE_MULTIPLIER,
+  [ GRAPH_ATTRIBUTE_MULTIPLICAND    ] = ATTRIBUTE_MULTIPLICAND,
+  [ GRAPH_ATTRIBUTE_DIVIDEND        ] = ATTRIBUTE_DIVIDEND,
+  [ GRAPH_ATTRIBUTE_DIVISOR         ] = ATTRIBUTE_DIVISOR,
+  [ GRAPH_ATTRIBUTE_LEFT_COMPARATE  ] = ATTRIBUTE_LEFT_COMPARATE,
+  [ GRAPH_ATTRIBUTE_RIGHT_COMPARATE ] = ATTRIBUTE_RIGHT_COMPARATE,
+  [ GRAPH_ATTRIBUTE_LEFT_CONJUNCT   ] = ATTRIBUTE_LEFT_CONJUNCT,
+  [ GRAPH_ATTRIBUTE_RIGHT_CONJUNCT  ] = ATTRIBUTE_RIGHT_CONJUNCT,
+  [ GRAPH_ATTRIBUTE_LEFT_DISJUNCT   ] = ATTRIBUTE_LEFT_DISJUNCT,
+  [ GRAPH_ATTRIBUTE_RIGHT_DISJUNCT  ] = ATTRIBUTE_RIGHT_DISJUNCT,
+  [ GRAPH_ATTRIBUTE_MINIMUM         ] = ATTRIBUTE_MINIMUM,
+  [ GRAPH_ATTRIBUTE_MAXIMUM         ] = ATTRIBUTE_MAXIMUM,
+  [ GRAPH_ATTRIBUTE_RATE            ] = ATTRIBUTE_RATE,
+  [ GRAPH_ATTRIBUTE_TIME            ] = ATTRIBUTE_TIME,
+  [ GRAPH_ATTRIBUTE_X               ] = ATTRIBUTE_X,
+  [ GRAPH_ATTRIBUTE_Y               ] = ATTRIBUTE_Y,
+  [ GRAPH_ATTRIBUTE_INPUT           ] = ATTRIBUTE_INPUT,
+  [ GRAPH_ATTRIBUTE_REGISTER        ] = ATTRIBUTE_REGISTER,
+  [ GRAPH_ATTRIBUTE_INDEX           ] = ATTRIBUTE_INDEX,
+  [ GRAPH_ATTRIBUTE_OCTAVE          ] = ATTRIBUTE_OCTAVE,
+  [ GRAPH_ATTRIBUTE_PITCH           ] = ATTRIBUTE_PITCH,
+  [ GRAPH_ATTRIBUTE_VOLUME          ] = ATTRIBUTE_VOLUME,
+  [ GRAPH_ATTRIBUTE_ATTACK          ] = ATTRIBUTE_ATTACK,
+  [ GRAPH_ATTRIBUTE_HOLD            ] = ATTRIBUTE_HOLD,
+  [ GRAPH_ATTRIBUTE_RELEASE         ] = ATTRIBUTE_RELEASE,
+  [ GRAPH_ATTRIBUTE_SOUND_INDEX     ] = ATTRIBUTE_SOUND_INDEX,
+  [ GRAPH_ATTRIBUTE_START_TIME      ] = ATTRIBUTE_START_TIME,
+  [ GRAPH_ATTRIBUTE_WAVEFORM        ] = ATTRIBUTE_WAVEFORM,
+  [ GRAPH_ATTRIBUTE_OUTPUT          ] = ATTRIBUTE_OUTPUT,
+};
+
+// the characters typed to enter each operator
+static const ValueTag character_tag_table[CHAR_MAX + 1] = {
+  [ '!' ]       = VALUE_BANG       ,
+  [ '+' ]       = VALUE_ADD        ,
+  [ '-' ]       = VALUE_SUB        ,
+  [ '*' ]       = VALUE_MUL        ,
+  [ '/' ]       = VALUE_DIV        ,
+  [ '=' ]       = VALUE_EQUAL      ,
+  [ '>' ]       = VALUE_GREATER    ,
+  [ '<' ]       = VALUE_LESSER     ,
+  [ '&' ]       = VALUE_AND        ,
+  [ '|' ]       = VALUE_OR         ,
+  [ 'a' ]       = VALUE_ALTER      ,
+  [ 'b' ]       = VALUE_BOTTOM     ,
+  [ 'c' ]       = VALUE_CLOCK      ,
+  [ 'd' ]       = VALUE_DELAY      ,
+  [ 'h' ]       = VALUE_HOP        ,
+  [ 'i' ]       = VALUE_INTERFERE  ,
+  [ 'j' ]       = VALUE_JUMP       ,
+  [ 'l' ]       = VALUE_LOAD       ,
+  [ 'm' ]       = VALUE_MULTIPLEX  ,
+  [ 'n' ]       = VALUE_NOTE       ,
+  [ 'o' ]       = VALUE_ODDMENT    ,
+  [ 'q' ]       = VALUE_QUOTE      ,
+  [ 'r' ]       = VALUE_RANDOM     ,
+  [ 's' ]       = VALUE_STORE      ,
+  [ 't' ]       = VALUE_TOP        ,
+  [ 'w' ]       = VALUE_WAVE       ,
+  [ 'x' ]       = VALUE_SAMPLER    ,
+  [ 'y' ]       = VALUE_SYNTH      ,
+  [ 'z' ]       = VALUE_MIDI       ,
+};
+
+ValueTag character_tag(Char c)
+{
+  return c >= 0 ? character_tag_table[(U8) c] : VALUE_NONE;
+}
+
+S32 character_literal(Char c)
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'A' && c <= 'Z') {
+    return c - 'A' + 10;
+  } else {
+    return -1;
+  }
+}
+
 const Value value_none      = { 0 };
 const Value value_bang      = { .tag = VALUE_BANG };
 const Value value_add       = { .tag = VALUE_ADD };
@@ -46,6 +127,7 @@ const Value value_quote     = { .tag = VALUE_QUOTE };
 const Value value_random    = { .tag = VALUE_RANDOM };
 const Value value_store     = { .tag = VALUE_STORE };
 const Value value_top       = { .tag = VALUE_TOP };
+const Value value_wave      = { .tag = VALUE_WAVE };
 const Value value_synth     = { .tag = VALUE_SYNTH };
 const Value value_sampler   = { .tag = VALUE_SAMPLER };
 
@@ -83,7 +165,7 @@ static const Bool quotation_table[VALUE_CARDINAL] = {
   [ VALUE_TOP       ] = true,
   [ VALUE_U         ] = false,
   [ VALUE_V         ] = false,
-  [ VALUE_W         ] = false,
+  [ VALUE_WAVE      ] = true,
   [ VALUE_SAMPLER   ] = true,
   [ VALUE_SYNTH     ] = true,
   [ VALUE_MIDI      ] = true,
@@ -101,14 +183,20 @@ static inline S32 map_zero(S32 value, S32 revert)
   return value == 0 ? revert : value;
 }
 
-static GraphEdge graph_edge(GraphEdgeTag tag, V2S origin, V2S target, ValueTag cause, const Char* attribute)
+static GraphEdge graph_edge(V2S origin, V2S target, ValueTag cause, GraphAttribute attribute)
 {
+  const V2S delta = v2s_sub(target, origin);
+  ASSERT(origin.x >= 0 && origin.x <= UINT16_MAX);
+  ASSERT(origin.y >= 0 && origin.y <= UINT16_MAX);
+  ASSERT(delta.x >= INT8_MIN && delta.x <= INT8_MAX);
+  ASSERT(delta.y >= INT8_MIN && delta.y <= INT8_MAX);
   GraphEdge edge;
-  edge.tag = tag;
-  edge.origin = origin;
-  edge.target = target;
-  edge.cause = cause;
-  edge.attribute = attribute;
+  edge.x = (U16) origin.x;
+  edge.y = (U16) origin.y;
+  edge.dx = (S8) delta.x;
+  edge.dy = (S8) delta.y;
+  edge.cause = (U8) cause;
+  edge.attribute = (U8) attribute;
   return edge;
 }
 
@@ -122,31 +210,131 @@ static Void record_graph_edge(Graph* graph, GraphEdge edge)
   }
 }
 
-static Value record_read(const Model* m, Graph* g, V2S origin, V2S offset, ValueTag cause, const Char* attribute)
+// Charge an event to the operator under evaluation. Outside of an operator,
+// as for writes made by the caller, there is nothing to charge.
+static Void profile_fire(const Model* m)
+{
+  ModelProfile* const profile = m->profile;
+  if (profile && profile->tag) {
+    profile->tag->fires += 1;
+    if (profile->tile) {
+      profile->tile->fires += 1;
+    }
+  }
+}
+
+static Void profile_read(const Model* m)
+{
+  ModelProfile* const profile = m->profile;
+  if (profile && profile->tag) {
+    profile->tag->reads += 1;
+    if (profile->tile) {
+      profile->tile->reads += 1;
+    }
+  }
+}
+
+static Void profile_write(const Model* m)
+{
+  ModelProfile* const profile = m->profile;
+  if (profile && profile->tag) {
+    profile->tag->writes += 1;
+    if (profile->tile) {
+      profile->tile->writes += 1;
+    }
+  }
+}
+
+// The table slot of a tile, found by linear probing. One slot always stays
+// empty, so that a probe for an absent tile ends.
+static Index profile_find(const ModelProfile* profile, Index tile)
+{
+  const Index mask = profile->capacity - 1;
+  Index slot = (Index) (((U64) tile * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+  while (profile->tiles[slot] != tile && profile->tiles[slot] != INDEX_NONE) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+// the counters of a tile, added unless the table is full or shared
+static ProfileCounter* profile_slot(ModelProfile* profile, Index tile)
+{
+  if (profile->capacity == 0) {
+    return NULL;
+  }
+  const Index slot = profile_find(profile, tile);
+  if (profile->tiles[slot] == INDEX_NONE) {
+    if (profile->shared || profile->length + 1 >= profile->capacity) {
+      return NULL;
+    }
+    profile->tiles[slot] = tile;
+    profile->length += 1;
+  }
+  return &profile->cells[slot];
+}
+
+static U64 profile_begin(const Model* m, Index x, Index y)
+{
+  ModelProfile* const profile = m->profile;
+  profile->tile = profile_slot(profile, y * m->dimensions.x + x);
+  profile->tag = &profile->tags[cell_tag(MODEL_INDEX(m, x, y))];
+  return profile->clock ? profile->clock() : 0;
+}
+
+static Void profile_end(const Model* m, U64 begin)
+{
+  ModelProfile* const profile = m->profile;
+  if (profile->clock) {
+    const U64 ticks = profile->clock() - begin;
+    profile->tag->ticks += ticks;
+    if (profile->tile) {
+      profile->tile->ticks += ticks;
+    }
+  }
+  profile->tile = NULL;
+  profile->tag = NULL;
+}
+
+static Bool profile_visit(const Model* m, Index x, Index y)
+{
+  return m->profile && cell_tag(MODEL_INDEX(m, x, y)) > VALUE_BANG;
+}
+
+// read an operand at a fixed offset, which the apron keeps in bounds
+static Value record_read(const Model* m, Graph* g, V2S origin, V2S offset, ValueTag cause, GraphAttribute attribute)
+{
+  const V2S target = v2s_sub(origin, offset);
+  const Value input = model_peek(m, target);
+  profile_read(m);
+  if (g) {
+    record_graph_edge(g, graph_edge(origin, target, cause, attribute));
+  }
+  return input;
+}
+
+// read an operand at an offset taken from cell data
+static Value record_read_checked(const Model* m, Graph* g, V2S origin, V2S offset, ValueTag cause, GraphAttribute attribute)
 {
   const V2S target = v2s_sub(origin, offset);
   const Value input = model_get(m, target);
-  const GraphEdge edge = graph_edge(
-      GRAPH_EDGE_INPUT,
-      origin,
-      target,
-      cause,
-      attribute);
-  record_graph_edge(g, edge);
+  profile_read(m);
+  if (g) {
+    record_graph_edge(g, graph_edge(origin, target, cause, attribute));
+  }
   return input;
 }
 
-static Void record_write(Model* m, Graph* g, V2S origin, V2S offset, ValueTag cause, const Char* attribute, Value v)
+static Void record_write(Model* m, Graph* g, V2S origin, V2S offset, ValueTag cause, GraphAttribute attribute, Value v)
 {
   const V2S target = v2s_add(origin, offset);
   model_set(m, target, v);
-  const GraphEdge edge = graph_edge(
-      GRAPH_EDGE_OUTPUT,
-      origin,
-      target,
-      cause,
-      attribute);
-  record_graph_edge(g, edge);
+  if (valid_point(m->dimensions, target)) {
+    profile_write(m);
+  }
+  if (g) {
+    record_graph_edge(g, graph_edge(origin, target, cause, attribute));
+  }
 }
 
 Bool is_operator(Value value)
@@ -188,369 +376,2134 @@ V2S add_unit_vector(V2S point, Direction d)
   return v2s_add(point, uv);
 }
 
+typedef enum ZobristDomain {
+  ZOBRIST_MEMORY = 1,
+  ZOBRIST_REGISTER,
+  ZOBRIST_RANDOM,
+} ZobristDomain;
+
+// Zobrist keys are mixed on demand rather than looked up, since a table
+// would need an entry for every cell value at every tile. Zero values have a
+// zero key, so empty tiles and registers leave the hash alone.
+static U64 zobrist_key(ZobristDomain domain, U64 index, U64 value)
+{
+  if (value == 0) {
+    return 0;
+  }
+  U64 z = (U64) domain * 0x9E3779B97F4A7C15ull + (index << 16 | value);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+static U64 zobrist_random(const rnd_pcg_t* rnd)
+{
+  U64 words[sizeof(rnd_pcg_t) / sizeof(U64)];
+  memcpy(words, rnd, sizeof(words));
+  U64 key = 0;
+  for (Index i = 0; i < (Index) (sizeof(words) / sizeof(U64)); i++) {
+    key ^= zobrist_key(ZOBRIST_RANDOM, i, words[i]);
+  }
+  return key;
+}
+
+_Static_assert(sizeof(rnd_pcg_t) % sizeof(U64) == 0, "random state should be whole words");
+
+// write a tile, keeping the hash current
+static Void cell_assign(Model* m, Index i, Cell cell)
+{
+  Cell* const target = &m->memory[i];
+  if (*target != cell) {
+    m->register_file->hash ^= zobrist_key(ZOBRIST_MEMORY, i, *target) ^ zobrist_key(ZOBRIST_MEMORY, i, cell);
+    *target = cell;
+  }
+}
+
+// write a register, keeping the hash current
+static Void register_assign(RegisterFile* rf, S32 r, Cell cell)
+{
+  rf->hash ^= zobrist_key(ZOBRIST_REGISTER, r, rf->registers[r]) ^ zobrist_key(ZOBRIST_REGISTER, r, cell);
+  rf->registers[r] = cell;
+}
+
+// draw a random number, keeping the hash current
+static U32 register_random(RegisterFile* rf)
+{
+  rf->hash ^= zobrist_random(&rf->rnd);
+  const U32 out = rnd_pcg_next(&rf->rnd);
+  rf->hash ^= zobrist_random(&rf->rnd);
+  return out;
+}
+
+U64 model_hash(const Model* m)
+{
+  const RegisterFile* const rf = m->register_file;
+  U64 hash = zobrist_random(&rf->rnd);
+  for (S32 r = 0; r < MODEL_RADIX; r++) {
+    hash ^= zobrist_key(ZOBRIST_REGISTER, r, rf->registers[r]);
+  }
+  // the apron is empty, so it adds nothing
+  const Index cells = MODEL_CELLS(m->dimensions);
+  for (Index i = 0; i < cells; i++) {
+    hash ^= zobrist_key(ZOBRIST_MEMORY, i, m->memory[i]);
+  }
+  return hash;
+}
+
+// operators and bangs
+static Bool is_active(Cell cell)
+{
+  return cell_tag(cell) >= VALUE_BANG;
+}
+
+static Void plane_assign(U64* plane, Index stride, Index x, Index y, Bool bit)
+{
+  U64* const word = &plane[y * stride + x / PLANE_BITS];
+  const U64 mask = ((U64) 1) << (x % PLANE_BITS);
+  *word = bit ? (*word | mask) : (*word & ~mask);
+}
+
+static Bool plane_test(const U64* plane, Index stride, Index x, Index y)
+{
+  return (plane[y * stride + x / PLANE_BITS] >> (x % PLANE_BITS)) & 1;
+}
+
+// test for a bang on any side of a tile, using the bang plane
+static Bool plane_bang_adjacent(const ModelIndex* index, V2S dimensions, V2S point)
+{
+  Bool bang = false;
+  for (Direction d = 0; d < DIRECTION_CARDINAL; d++) {
+    const V2S c = add_unit_vector(point, d);
+    if (valid_point(dimensions, c)) {
+      bang = bang || plane_test(index->bangs, index->stride, c.x, c.y);
+    }
+  }
+  return bang;
+}
+
+static Void index_assign(ModelIndex* index, V2S dimensions, V2S point, Cell cell)
+{
+  const Index stride = index->stride;
+  const Bool bang = cell_tag(cell) == VALUE_BANG;
+  plane_assign(index->active, stride, point.x, point.y, is_active(cell));
+  const V2S chunk = { point.x / MODEL_CHUNK, point.y / MODEL_CHUNK };
+  if (cell != 0 && plane_test(index->chunks, index->chunk_stride, chunk.x, chunk.y) == false) {
+    plane_assign(index->chunks, index->chunk_stride, chunk.x, chunk.y, true);
+  }
+
+  // Neighbours gain adjacency when a bang appears. When one disappears, they
+  // keep it only if another bang still borders them.
+  if (plane_test(index->bangs, stride, point.x, point.y) != bang) {
+    plane_assign(index->bangs, stride, point.x, point.y, bang);
+    for (Direction d = 0; d < DIRECTION_CARDINAL; d++) {
+      const V2S c = add_unit_vector(point, d);
+      if (valid_point(dimensions, c)) {
+        const Bool adjacent = bang || plane_bang_adjacent(index, dimensions, c);
+        plane_assign(index->adjacent, stride, c.x, c.y, adjacent);
+      }
+    }
+  }
+}
+
+Void model_index_adjacency_row(
+    U64* out,
+    const U64* north,
+    const U64* row,
+    const U64* south,
+    Index stride,
+    S32 width)
+{
+  for (Index w = 0; w < stride; w++) {
+    const U64 west = row[w] << 1 | (w > 0 ? row[w - 1] >> (PLANE_BITS - 1) : 0);
+    const U64 east = row[w] >> 1 | (w + 1 < stride ? row[w + 1] << (PLANE_BITS - 1) : 0);
+    const U64 vertical = (north ? north[w] : 0) | (south ? south[w] : 0);
+    out[w] = west | east | vertical;
+  }
+
+  // the westward shift can carry a bit into the row padding
+  const S32 residue = width % PLANE_BITS;
+  if (residue != 0) {
+    out[stride - 1] &= (((U64) 1) << residue) - 1;
+  }
+}
+
+static Index plane_stride(V2S dimensions)
+{
+  return (dimensions.x + PLANE_BITS - 1) / PLANE_BITS;
+}
+
+Index model_index_words(V2S dimensions)
+{
+  return plane_stride(dimensions) * dimensions.y;
+}
+
+static V2S chunk_dimensions(V2S dimensions)
+{
+  const S32 x = (dimensions.x + MODEL_CHUNK - 1) / MODEL_CHUNK;
+  const S32 y = (dimensions.y + MODEL_CHUNK - 1) / MODEL_CHUNK;
+  return v2s(x, y);
+}
+
+Index model_chunk_words(V2S dimensions)
+{
+  return model_index_words(chunk_dimensions(dimensions));
+}
+
+Bool model_chunk_run(const ModelIndex* index, V2S dimensions, S32 y, S32* begin, S32* end)
+{
+  const S32 width = chunk_dimensions(dimensions).x;
+  const S32 cy = y / MODEL_CHUNK;
+  // the last run on a row is clipped to the grid, so round up past it
+  S32 cx = (*end + MODEL_CHUNK - 1) / MODEL_CHUNK;
+  while (cx < width && plane_test(index->chunks, index->chunk_stride, cx, cy) == false) {
+    cx += 1;
+  }
+  if (cx == width) {
+    return false;
+  }
+  *begin = cx * MODEL_CHUNK;
+  while (cx < width && plane_test(index->chunks, index->chunk_stride, cx, cy)) {
+    cx += 1;
+  }
+  *end = MIN(cx * MODEL_CHUNK, dimensions.x);
+  return true;
+}
+
+Void model_chunk_copy(const ModelIndex* index, V2S dimensions, Cell* dst, const Cell* src)
+{
+  for (S32 y = 0; y < dimensions.y; y++) {
+    S32 begin = 0;
+    S32 end = 0;
+    while (model_chunk_run(index, dimensions, y, &begin, &end)) {
+      const Index i = MODEL_OFFSET(dimensions, begin, y);
+      memcpy(&dst[i], &src[i], (end - begin) * sizeof(Cell));
+    }
+  }
+}
+
+Bool model_chunk_equal(const ModelIndex* index, V2S dimensions, const Cell* a, const Cell* b)
+{
+  for (S32 y = 0; y < dimensions.y; y++) {
+    S32 begin = 0;
+    S32 end = 0;
+    while (model_chunk_run(index, dimensions, y, &begin, &end)) {
+      const Index i = MODEL_OFFSET(dimensions, begin, y);
+      if (memcmp(&a[i], &b[i], (end - begin) * sizeof(Cell)) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// operators, which are the tiles the instruction stream covers
+static Bool is_compiled(Cell cell)
+{
+  return cell_tag(cell) > VALUE_BANG;
+}
+
+// queue a bang for a visit when the stream reaches it
+static Void program_defer(ModelProgram* program, Index i)
+{
+  // The interpreter only visits bangs ahead of its cursor. Without a valid
+  // stream, it visits them all.
+  if (i <= program->cursor || program->valid == false) {
+    return;
+  }
+  ASSERT(program->pending_length < program->capacity);
+
+  // insert in reading order, ignoring duplicates
+  Index j = program->pending_length;
+  while (j > program->pending_head && program->pending[j - 1] > i) {
+    j -= 1;
+  }
+  if (j > program->pending_head && program->pending[j - 1] == i) {
+    return;
+  }
+  memmove(
+      &program->pending[j + 1],
+      &program->pending[j],
+      (program->pending_length - j) * sizeof(Index));
+  program->pending[j] = i;
+  program->pending_length += 1;
+}
+
+static Void program_observe(ModelProgram* program, Index i, Cell before, Cell after)
+{
+  const Bool retagged = cell_tag(before) != cell_tag(after);
+  if (retagged && (is_compiled(before) || is_compiled(after))) {
+    program->valid = false;
+  }
+  if (cell_tag(after) == VALUE_BANG) {
+    program_defer(program, i);
+  }
+}
+
+Void model_index_rebuild(Model* m)
+{
+  // memory may have been written directly
+  if (m->program) {
+    m->program->valid = false;
+  }
+
+  ModelIndex* const index = m->index;
+  if (index) {
+    const Index stride = plane_stride(m->dimensions);
+    const Index words = model_index_words(m->dimensions);
+    index->stride = stride;
+    index->chunk_stride = plane_stride(chunk_dimensions(m->dimensions));
+    memset(index->active, 0, words * sizeof(U64));
+    memset(index->bangs, 0, words * sizeof(U64));
+
+    // Chunks stay marked, since other slots may still hold values in them.
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      for (Index x = 0; x < m->dimensions.x; x++) {
+        const Cell cell = MODEL_INDEX(m, x, y);
+        if (cell != 0) {
+          plane_assign(index->chunks, index->chunk_stride, x / MODEL_CHUNK, y / MODEL_CHUNK, true);
+        }
+        if (is_active(cell)) {
+          plane_assign(index->active, stride, x, y, true);
+        }
+        if (cell_tag(cell) == VALUE_BANG) {
+          plane_assign(index->bangs, stride, x, y, true);
+        }
+      }
+    }
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      model_index_adjacency_row(
+          &index->adjacent[y * stride],
+          y > 0 ? &index->bangs[(y - 1) * stride] : NULL,
+          &index->bangs[y * stride],
+          y + 1 < m->dimensions.y ? &index->bangs[(y + 1) * stride] : NULL,
+          stride,
+          m->dimensions.x);
+    }
+  }
+}
+
 Void model_init(Model* m)
 {
-  memset(m->memory, 0, m->dimensions.x * m->dimensions.y * sizeof(Value));
+  memset(m->memory, 0, MODEL_CELLS(m->dimensions) * sizeof(Cell));
   memset(m->register_file, 0, sizeof(RegisterFile));
   rnd_pcg_seed(&m->register_file->rnd, 0u);
+  m->register_file->hash = zobrist_random(&m->register_file->rnd);
+  model_index_rebuild(m);
 }
 
 Value model_get(const Model* m, V2S point)
 {
   if (valid_point(m->dimensions, point)) {
-    return MODEL_INDEX(m, point.x, point.y);
+    return value_of_cell(MODEL_INDEX(m, point.x, point.y));
   } else {
     return value_none;
   }
 }
 
+Value model_peek(const Model* m, V2S point)
+{
+  ASSERT(point.x >= -MODEL_APRON && point.x < m->dimensions.x + MODEL_APRON);
+  ASSERT(point.y >= -1 && point.y <= m->dimensions.y);
+  return value_of_cell(MODEL_INDEX(m, point.x, point.y));
+}
+
+V2S model_point(V2S dimensions, Index offset)
+{
+  const Index stride = MODEL_STRIDE(dimensions);
+  const Index row = offset - MODEL_APRON;
+  return v2s((S32) (row % stride), (S32) (row / stride - 1));
+}
+
 Void model_set(Model* m, V2S point, Value value)
 {
   if (valid_point(m->dimensions, point)) {
-    MODEL_INDEX(m, point.x, point.y) = value;
+    const Cell cell = cell_of_value(value);
+    const Index i = MODEL_OFFSET(m->dimensions, point.x, point.y);
+    if (m->program) {
+      program_observe(m->program, i, m->memory[i], cell);
+    }
+    cell_assign(m, i, cell);
+    if (m->index) {
+      index_assign(m->index, m->dimensions, point, cell);
+    }
   }
 }
 
-S32 read_literal(Value v, S32 none)
+static Index greatest_common_divisor(Index a, Index b)
 {
-  return v.tag == VALUE_LITERAL ? v.literal : none;
+  while (b != 0) {
+    const Index t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
 }
 
-Void model_step(Model* m, GraphEdge* graph_root)
+// fold the period of a frame-dependent evaluation into the model's
+static Void model_frame_period(const Model* m, Index period)
 {
-  const Index area = m->dimensions.x * m->dimensions.y;
-
-  // clear graph
-  memset(graph_root, 0, GRAPH_FACTOR * area * sizeof(GraphEdge));
+  Index* const frame_period = m->frame_period;
+  if (frame_period && *frame_period != 0) {
+    const Index lcm = *frame_period / greatest_common_divisor(*frame_period, period) * period;
+    *frame_period = lcm <= MODEL_FRAME_PERIOD_LIMIT ? lcm : 0;
+  }
+}
 
-  // set up graph context
-  Graph g = {
-    .capacity = GRAPH_FACTOR * area,
-    .head = 0,
-    .edges = graph_root,
-  };
+S32 read_literal(Value v, S32 none)
+{
+  return v.tag == VALUE_LITERAL ? v.literal : none;
+}
 
+static Void model_evaluate_tile(Model* m, Graph* g, Index x, Index y)
+{
   // shorthand
   RegisterFile* const rf = m->register_file;
 
-  // clear bangs and pulses
-  for (Index y = 0; y < m->dimensions.y; y++) {
-    for (Index x = 0; x < m->dimensions.x; x++) {
-      MODEL_INDEX(m, x, y).pulse = false;
-      if (MODEL_INDEX(m, x, y).tag == VALUE_BANG) {
-        MODEL_INDEX(m, x, y) = value_none;
-      }
+  const V2S origin = { (S32) x, (S32) y };
+  const Value value = value_of_cell(MODEL_INDEX(m, x, y));
+
+  // check for adjacent bang
+  Bool bang = false;
+  if (m->index) {
+    bang = plane_test(m->index->adjacent, m->index->stride, x, y);
+  } else {
+    for (Direction d = 0; d < DIRECTION_CARDINAL; d++) {
+      const Value adjacent = model_peek(m, add_unit_vector(origin, d));
+      bang = bang || adjacent.tag == VALUE_BANG;
     }
   }
 
-  // iterate in English reading order
-  for (Index y = 0; y < m->dimensions.y; y++) {
-    for (Index x = 0; x < m->dimensions.x; x++) {
+  // mark pulse
+  if (value.powered == false && bang && value.pulse == false) {
+    cell_assign(m, MODEL_OFFSET(m->dimensions, x, y), MODEL_INDEX(m, x, y) | CELL_PULSE);
+  }
 
-      const V2S origin = { (S32) x, (S32) y };
-      const Value value = MODEL_INDEX(m, x, y);
+  if (value.powered || bang) {
 
-      // cache adjacent coordinates and values
-      Bool bang = false;
-      for (Direction d = 0; d < DIRECTION_CARDINAL; d++) {
-        const Value adjacent = model_get(m, add_unit_vector(origin, d));
-        bang = bang || adjacent.tag == VALUE_BANG;
-      }
+    profile_fire(m);
+
+    switch (value.tag) {
+
+      case VALUE_ADD:
+        {
+          const Value augend = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_ADDEND);
+          const Value addend = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_ADDEND);
+          const S32 output = (read_literal(augend, 0) + read_literal(addend, 0)) % MODEL_RADIX;
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_literal(output));
+        } break;
+
+      case VALUE_SUB:
+        {
+          const Value minuend    = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_MINUEND);
+          const Value subtrahend = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_SUBTRAHEND);
+          const S32 difference = read_literal(minuend, 0) - read_literal(subtrahend, 0);
+          const S32 output = difference < 0 ? difference + MODEL_RADIX : difference;
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_literal(output));
+        } break;
+
+      case VALUE_MUL:
+        {
+          const Value multiplier   = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_MULTIPLIER);
+          const Value multiplicand = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_MULTIPLICAND);
+          const S32 output = (read_literal(multiplier, 0) * read_literal(multiplicand, 0)) % MODEL_RADIX;
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_literal(output));
+        } break;
+
+      case VALUE_DIV:
+        {
+          const Value dividend = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_DIVIDEND);
+          const Value divisor  = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_DIVISOR);
+          const S32 divisor_literal = read_literal(divisor, 0);
+          if (divisor_literal != 0) {
+            const S32 quotient = read_literal(dividend, 0) / divisor_literal;
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_literal(quotient));
+          } else {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_none);
+          }
+        } break;
+
+      case VALUE_EQUAL:
+        {
+          // How should equality (and inequality) behave when comparing operators?
+          const Value lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_COMPARATE);
+          const Value rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_COMPARATE);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            if (lhs.literal == rhs.literal) {
+              record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_bang);
+            }
+          }
+        } break;
+
+      case VALUE_GREATER:
+        {
+          const Value lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_COMPARATE);
+          const Value rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_COMPARATE);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            if (lhs.literal > rhs.literal) {
+              record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_bang);
+            }
+          }
+        } break;
+
+      case VALUE_LESSER:
+        {
+          const Value lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_COMPARATE);
+          const Value rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_COMPARATE);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            if (lhs.literal < rhs.literal) {
+              record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_bang);
+            }
+          }
+        } break;
+
+      case VALUE_AND:
+        {
+          const Value lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_CONJUNCT);
+          const Value rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_CONJUNCT);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            const Value output = value_literal(lhs.literal & rhs.literal);
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+          } else if (lhs.tag != VALUE_NONE && rhs.tag != VALUE_NONE) {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_bang);
+          }
+        } break;
+
+      case VALUE_OR:
+        {
+          const Value lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_DISJUNCT);
+          const Value rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_DISJUNCT);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            const Value output = value_literal((lhs.literal | rhs.literal) % MODEL_RADIX);
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+          } else if (lhs.tag != VALUE_NONE || rhs.tag != VALUE_NONE) {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_bang);
+          }
+        } break;
+
+      case VALUE_ALTER:
+        {
+          const Value t   = record_read(m, g, origin, v2s(3, 0), value.tag, GRAPH_ATTRIBUTE_TIME);
+          const Value lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_MINIMUM);
+          const Value rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_MAXIMUM);
+          const S32 lhsv = read_literal(lhs, 0);
+          const S32 rhsv = read_literal(rhs, 0);
+          const S32 tv   = read_literal(t, 0);
+          const S32 scale = MODEL_RADIX - 1;
+          const S32 output = ((scale - tv) * lhsv + tv * rhsv) / scale;
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_literal(output));
+        } break;
+
+      case VALUE_BOTTOM:
+        {
+          const Value input_lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_COMPARATE);
+          const Value input_rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_COMPARATE);
+          const S32 lhs = read_literal(input_lhs, MODEL_RADIX - 1);
+          const S32 rhs = read_literal(input_rhs, MODEL_RADIX - 1);
+          const Value output = value_literal(MIN(lhs, rhs));
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+        } break;
+
+      case VALUE_CLOCK:
+        {
+          const Value input_rate = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_RATE);
+          const Value input_mod  = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_DIVISOR);
+          const S32 rate = read_literal(input_rate, 0) + 1;
+          const S32 mod = map_zero(read_literal(input_mod, 0), MODEL_RADIX);
+          model_frame_period(m, rate * mod);
+          if (rf->frame % rate == 0) {
+            const Value output = value_literal((rf->frame / rate) % mod);
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+          }
+        } break;
+
+      case VALUE_DELAY:
+        {
+          const Value input_rate = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_RATE);
+          const Value input_mod  = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_DIVISOR);
+          const S32 rate = read_literal(input_rate, 0) + 1;
+          const S32 mod = map_zero(read_literal(input_mod, 1), MODEL_RADIX);
+          model_frame_period(m, rate * mod);
+          const S32 output = (rf->frame / rate) % mod;
+          if (output == 0) {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_bang);
+          }
+        } break;
+
+      case VALUE_HOP:
+        {
+          // Whether we should apply the hop to nil values is unclear to me.
+          const Value input = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_INPUT);
+          record_write(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_OUTPUT, input);
+        } break;
+
+      case VALUE_INTERFERE:
+        {
+          // Again, what to do in the nil input case is unclear to me.
+          const Value iv = record_read(m, g, origin, v2s(3, 0), value.tag, GRAPH_ATTRIBUTE_INPUT);
+          const Value xv = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_X);
+          const Value yv = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_Y);
+          const V2S delta = { read_literal(xv, 0), read_literal(yv, 0) + 1 };
+          record_write(m, g, origin, delta, value.tag, GRAPH_ATTRIBUTE_OUTPUT, iv);
+        } break;
+
+      case VALUE_JUMP:
+        {
+          const Value input = record_read(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_INPUT);
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, input);
+        } break;
+
+      case VALUE_LOAD:
+        {
+          const Value reg = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_REGISTER);
+          if (reg.tag == VALUE_LITERAL) {
+            const Value v = value_of_cell(rf->registers[reg.literal]);
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, v);
+          } else {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_none);
+          }
+        } break;
+
+      case VALUE_MULTIPLEX:
+        {
+          const Value xv = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_X);
+          const Value yv = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_Y);
+          const V2S delta = { - (read_literal(xv, 0) + 1), read_literal(yv, 0) };
+          const Value iv = record_read_checked(m, g, origin, delta, value.tag, GRAPH_ATTRIBUTE_INPUT);
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, iv);
+        } break;
+
+      case VALUE_NOTE:
+        {
+          const Value input_index = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_INDEX);
+          const S32 index = read_literal(input_index, 0);
+          const S32 octave  = index / SCALE_CARDINAL;
+          const S32 note    = index % SCALE_CARDINAL;
+          const S32 pitch   = (OCTAVE * octave + scale_table[note]) % MODEL_RADIX;
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_literal(pitch));
+        } break;
+
+      case VALUE_ODDMENT:
+        {
+          const Value input_dividend = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_DIVIDEND);
+          const Value input_divisor  = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_DIVISOR);
+          const S32 dividend = read_literal(input_dividend, 0);
+          const S32 divisor = map_zero(read_literal(input_divisor, 0), MODEL_RADIX);
+          const Value residue = value_literal(dividend % divisor);
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, residue);
+        } break;
+
+      case VALUE_QUOTE:
+        {
+          const Value index = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_INDEX);
+          if (index.tag == VALUE_LITERAL) {
+            const Value output = {
+              .tag = VALUE_BANG + index.literal,
+              .powered = true,
+            };
+            if (quotation_table[output.tag]) {
+              record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+            } else {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_none);
+            }
+          } else {
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, value_none);
+          }
+        } break;
+
+      case VALUE_RANDOM:
+        {
+          const Value input_rate = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_RATE);
+          const Value input_mod = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_DIVISOR);
+          const S32 rate = read_literal(input_rate, 0) + 1;
+          model_frame_period(m, rate);
+          if (rf->frame % rate == 0) {
+            const S32 mod = map_zero(read_literal(input_mod, 0), MODEL_RADIX);
+            const Value output = value_literal(register_random(rf) % mod);
+            record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+          }
+        } break;
+
+      case VALUE_STORE:
+        {
+          const Value set = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_INPUT);
+          const Value reg = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_REGISTER);
+          if (reg.tag == VALUE_LITERAL) {
+            register_assign(rf, reg.literal, cell_of_value(set));
+          }
+        } break;
+
+      case VALUE_TOP:
+        {
+          const Value input_lhs = record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_LEFT_COMPARATE);
+          const Value input_rhs = record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RIGHT_COMPARATE);
+          const S32 lhs = read_literal(input_lhs, 0);
+          const S32 rhs = read_literal(input_rhs, 0);
+          const Value output = value_literal(MAX(lhs, rhs));
+          record_write(m, g, origin, v2s(0, 1), value.tag, GRAPH_ATTRIBUTE_OUTPUT, output);
+        } break;
 
-      // mark pulse
-      if (value.powered == false && bang) {
-        MODEL_INDEX(m, x, y).pulse = true;
+      case VALUE_SYNTH:
+        {
+          // These coordinates have to be kept in sync with the logic in
+          // the simulation module. The operands are taken by `event_collect`,
+          // so these reads only record the graph.
+          if (g) {
+            record_read(m, g, origin, v2s(6, 0), value.tag, GRAPH_ATTRIBUTE_OCTAVE);
+            record_read(m, g, origin, v2s(5, 0), value.tag, GRAPH_ATTRIBUTE_PITCH);
+            record_read(m, g, origin, v2s(4, 0), value.tag, GRAPH_ATTRIBUTE_VOLUME);
+            record_read(m, g, origin, v2s(3, 0), value.tag, GRAPH_ATTRIBUTE_ATTACK);
+            record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_HOLD);
+            record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RELEASE);
+          }
+        } break;
+
+      case VALUE_WAVE:
+        {
+          // the synth's operands, with the waveform further west
+          if (g) {
+            record_read(m, g, origin, v2s(7, 0), value.tag, GRAPH_ATTRIBUTE_WAVEFORM);
+            record_read(m, g, origin, v2s(6, 0), value.tag, GRAPH_ATTRIBUTE_OCTAVE);
+            record_read(m, g, origin, v2s(5, 0), value.tag, GRAPH_ATTRIBUTE_PITCH);
+            record_read(m, g, origin, v2s(4, 0), value.tag, GRAPH_ATTRIBUTE_VOLUME);
+            record_read(m, g, origin, v2s(3, 0), value.tag, GRAPH_ATTRIBUTE_ATTACK);
+            record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_HOLD);
+            record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_RELEASE);
+          }
+        } break;
+
+      case VALUE_SAMPLER:
+        {
+          if (g) {
+            record_read(m, g, origin, v2s(7, 0), value.tag, GRAPH_ATTRIBUTE_SOUND_INDEX);
+            record_read(m, g, origin, v2s(6, 0), value.tag, GRAPH_ATTRIBUTE_START_TIME);
+            record_read(m, g, origin, v2s(5, 0), value.tag, GRAPH_ATTRIBUTE_VOLUME);
+            record_read(m, g, origin, v2s(4, 0), value.tag, GRAPH_ATTRIBUTE_ATTACK);
+            record_read(m, g, origin, v2s(3, 0), value.tag, GRAPH_ATTRIBUTE_HOLD);
+            record_read(m, g, origin, v2s(2, 0), value.tag, GRAPH_ATTRIBUTE_RELEASE);
+            record_read(m, g, origin, v2s(1, 0), value.tag, GRAPH_ATTRIBUTE_PITCH);
+          }
+        } break;
+
+      default: { }
+    }
+  }
+}
+
+static Void model_step_tile(Model* m, Graph* g, Index x, Index y)
+{
+  if (profile_visit(m, x, y)) {
+    const U64 begin = profile_begin(m, x, y);
+    model_evaluate_tile(m, g, x, y);
+    profile_end(m, begin);
+  } else {
+    model_evaluate_tile(m, g, x, y);
+  }
+}
+
+// Iterate over active tiles in English reading order, starting from a given
+// tile. The word is reread after each tile, so operators written ahead of the
+// cursor are visited.
+static Void model_step_from(Model* m, Graph* g, Index x0, Index y0)
+{
+  const ModelIndex* const index = m->index;
+  for (Index y = y0; y < m->dimensions.y; y++) {
+    const Index start = y == y0 ? x0 : 0;
+    for (Index w = 0; w < index->stride; w++) {
+      const Index skip = start - w * PLANE_BITS;
+      if (skip >= PLANE_BITS) {
+        continue;
       }
-      
-      if (value.powered || bang) {
-
-        switch (value.tag) {
-
-          case VALUE_ADD:
-            {
-              const Value augend = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_ADDEND);
-              const Value addend = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_ADDEND);
-              const S32 output = (read_literal(augend, 0) + read_literal(addend, 0)) % MODEL_RADIX;
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_literal(output));
-            } break;
-
-          case VALUE_SUB:
-            {
-              const Value minuend    = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_MINUEND);
-              const Value subtrahend = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_SUBTRAHEND);
-              const S32 difference = read_literal(minuend, 0) - read_literal(subtrahend, 0);
-              const S32 output = difference < 0 ? difference + MODEL_RADIX : difference;
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_literal(output));
-            } break;
-
-          case VALUE_MUL:
-            {
-              const Value multiplier   = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_MULTIPLIER);
-              const Value multiplicand = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_MULTIPLICAND);
-              const S32 output = (read_literal(multiplier, 0) * read_literal(multiplicand, 0)) % MODEL_RADIX;
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_literal(output));
-            } break;
-
-          case VALUE_DIV:
-            {
-              const Value dividend = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_DIVIDEND);
-              const Value divisor  = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_DIVISOR);
-              const S32 divisor_literal = read_literal(divisor, 0);
-              if (divisor_literal != 0) {
-                const S32 quotient = read_literal(dividend, 0) / divisor_literal;
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_literal(quotient));
-              } else {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_none);
-              }
-            } break;
-
-          case VALUE_EQUAL:
-            {
-              // How should equality (and inequality) behave when comparing operators?
-              const Value lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_COMPARATE);
-              const Value rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_COMPARATE);
-              if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
-                if (lhs.literal == rhs.literal) {
-                  record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_bang);
-                }
-              }
-            } break;
-
-          case VALUE_GREATER:
-            {
-              const Value lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_COMPARATE);
-              const Value rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_COMPARATE);
-              if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
-                if (lhs.literal > rhs.literal) {
-                  record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_bang);
-                }
-              }
-            } break;
-
-          case VALUE_LESSER:
-            {
-              const Value lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_COMPARATE);
-              const Value rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_COMPARATE);
-              if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
-                if (lhs.literal < rhs.literal) {
-                  record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_bang);
-                }
-              }
-            } break;
-
-          case VALUE_AND:
-            {
-              const Value lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_CONJUNCT);
-              const Value rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_CONJUNCT);
-              if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
-                const Value output = value_literal(lhs.literal & rhs.literal);
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-              } else if (lhs.tag != VALUE_NONE && rhs.tag != VALUE_NONE) {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_bang);
-              }
-            } break;
-
-          case VALUE_OR:
-            {
-              const Value lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_DISJUNCT);
-              const Value rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_DISJUNCT);
-              if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
-                const Value output = value_literal((lhs.literal | rhs.literal) % MODEL_RADIX);
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-              } else if (lhs.tag != VALUE_NONE || rhs.tag != VALUE_NONE) {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_bang);
-              }
-            } break;
-
-          case VALUE_ALTER:
-            {
-              const Value t   = record_read(m, &g, origin, v2s(3, 0), value.tag, ATTRIBUTE_TIME);
-              const Value lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_MINIMUM);
-              const Value rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_MAXIMUM);
-              const S32 lhsv = read_literal(lhs, 0);
-              const S32 rhsv = read_literal(rhs, 0);
-              const S32 tv   = read_literal(t, 0);
-              const S32 scale = MODEL_RADIX - 1;
-              const S32 output = ((scale - tv) * lhsv + tv * rhsv) / scale;
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_literal(output));
-            } break;
-
-          case VALUE_BOTTOM:
-            {
-              const Value input_lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_COMPARATE);
-              const Value input_rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_COMPARATE);
-              const S32 lhs = read_literal(input_lhs, MODEL_RADIX - 1);
-              const S32 rhs = read_literal(input_rhs, MODEL_RADIX - 1);
-              const Value output = value_literal(MIN(lhs, rhs));
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-            } break;
-
-          case VALUE_CLOCK:
-            {
-              const Value input_rate = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_RATE);
-              const Value input_mod  = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_DIVISOR);
-              const S32 rate = read_literal(input_rate, 0) + 1;
-              if (rf->frame % rate == 0) {
-                const S32 mod = map_zero(read_literal(input_mod, 0), MODEL_RADIX);
-                const Value output = value_literal((rf->frame / rate) % mod);
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-              }
-            } break;
-
-          case VALUE_DELAY:
-            {
-              const Value input_rate = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_RATE);
-              const Value input_mod  = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_DIVISOR);
-              const S32 rate = read_literal(input_rate, 0) + 1;
-              const S32 mod = map_zero(read_literal(input_mod, 1), MODEL_RADIX);
-              const S32 output = (rf->frame / rate) % mod;
-              if (output == 0) {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_bang);
-              }
-            } break;
-
-          case VALUE_HOP:
-            {
-              // Whether we should apply the hop to nil values is unclear to me.
-              const Value input = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_INPUT);
-              record_write(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_OUTPUT, input);
-            } break;
-
-          case VALUE_INTERFERE:
-            {
-              // Again, what to do in the nil input case is unclear to me.
-              const Value iv = record_read(m, &g, origin, v2s(3, 0), value.tag, ATTRIBUTE_INPUT);
-              const Value xv = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_X);
-              const Value yv = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_Y);
-              const V2S delta = { read_literal(xv, 0), read_literal(yv, 0) + 1 };
-              record_write(m, &g, origin, delta, value.tag, ATTRIBUTE_OUTPUT, iv);
-            } break;
-
-          case VALUE_JUMP:
-            {
-              const Value input = record_read(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_INPUT);
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, input);
-            } break;
-
-          case VALUE_LOAD:
-            {
-              const Value reg = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_REGISTER);
-              if (reg.tag == VALUE_LITERAL) {
-                const Value v = rf->registers[reg.literal];
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, v);
-              } else {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_none);
-              }
-            } break;
-
-          case VALUE_MULTIPLEX:
-            {
-              const Value xv = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_X);
-              const Value yv = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_Y);
-              const V2S delta = { - (read_literal(xv, 0) + 1), read_literal(yv, 0) };
-              const Value iv = record_read(m, &g, origin, delta, value.tag, ATTRIBUTE_INPUT);
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, iv);
-            } break;
-
-          case VALUE_NOTE:
-            {
-              const Value input_index = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_INDEX);
-              const S32 index = read_literal(input_index, 0);
-              const S32 octave  = index / SCALE_CARDINAL;
-              const S32 note    = index % SCALE_CARDINAL;
-              const S32 pitch   = (OCTAVE * octave + scale_table[note]) % MODEL_RADIX;
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_literal(pitch));
-            } break;
-
-          case VALUE_ODDMENT:
-            {
-              const Value input_dividend = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_DIVIDEND);
-              const Value input_divisor  = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_DIVISOR);
-              const S32 dividend = read_literal(input_dividend, 0);
-              const S32 divisor = map_zero(read_literal(input_divisor, 0), MODEL_RADIX);
-              const Value residue = value_literal(dividend % divisor);
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, residue);
-            } break;
-
-          case VALUE_QUOTE:
-            {
-              const Value index = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_INDEX);
-              if (index.tag == VALUE_LITERAL) {
-                const Value output = {
-                  .tag = VALUE_BANG + index.literal,
-                  .powered = true,
-                };
-                if (quotation_table[output.tag]) {
-                  record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-                } else {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_none);
-                }
-              } else {
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, value_none);
-              }
-            } break;
-
-          case VALUE_RANDOM:
-            {
-              const Value input_rate = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_RATE);
-              const Value input_mod = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_DIVISOR);
-              const S32 rate = read_literal(input_rate, 0) + 1;
-              if (rf->frame % rate == 0) {
-                const S32 mod = map_zero(read_literal(input_mod, 0), MODEL_RADIX);
-                const Value output = value_literal(rnd_pcg_next(&rf->rnd) % mod);
-                record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-              }
-            } break;
-
-          case VALUE_STORE:
-            {
-              const Value set = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_INPUT);
-              const Value reg = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_REGISTER);
-              if (reg.tag == VALUE_LITERAL) {
-                rf->registers[reg.literal] = set;
-              }
-            } break;
-
-          case VALUE_TOP:
-            {
-              const Value input_lhs = record_read(m, &g, origin, v2s(2, 0), value.tag, ATTRIBUTE_LEFT_COMPARATE);
-              const Value input_rhs = record_read(m, &g, origin, v2s(1, 0), value.tag, ATTRIBUTE_RIGHT_COMPARATE);
-              const S32 lhs = read_literal(input_lhs, 0);
-              const S32 rhs = read_literal(input_rhs, 0);
-              const Value output = value_literal(MAX(lhs, rhs));
-              record_write(m, &g, origin, v2s(0, 1), value.tag, ATTRIBUTE_OUTPUT, output);
-            } break;
-
-          case VALUE_SYNTH:
-            {
-              // These coordinates have to be kept in sync with the logic in
-              // the simulation module.
-              record_read(m, &g, origin, v2s(6, 0), value.tag, "OCTAVE");
-              record_read(m, &g, origin, v2s(5, 0), value.tag, "PITCH");
-              record_read(m, &g, origin, v2s(4, 0), value.tag, "VOLUME");
-              record_read(m, &g, origin, v2s(3, 0), value.tag, "ATTACK");
-              record_read(m, &g, origin, v2s(2, 0), value.tag, "HOLD");
-              record_read(m, &g, origin, v2s(1, 0), value.tag, "RELEASE");
-            } break;
-
-          case VALUE_SAMPLER:
-            {
-              record_read(m, &g, origin, v2s(7, 0), value.tag, "SOUND INDEX");
-              record_read(m, &g, origin, v2s(6, 0), value.tag, "START TIME");
-              record_read(m, &g, origin, v2s(5, 0), value.tag, "VOLUME");
-              record_read(m, &g, origin, v2s(4, 0), value.tag, "ATTACK");
-              record_read(m, &g, origin, v2s(3, 0), value.tag, "HOLD");
-              record_read(m, &g, origin, v2s(2, 0), value.tag, "RELEASE");
-              record_read(m, &g, origin, v2s(1, 0), value.tag, "PITCH");
-            } break;
-
-          default: { }
-        }
+      const U64* const word = &index->active[y * index->stride + w];
+      U64 pending = skip > 0 ? *word & ~((((U64) 1) << skip) - 1) : *word;
+      while (pending) {
+        const S32 bit = u64_trailing_zeros(pending);
+        model_step_tile(m, g, w * PLANE_BITS + bit, y);
+        pending = *word & ~((((U64) 2) << bit) - 1);
       }
     }
   }
+}
 
-  rf->frame += 1;
+// memory offset of an operand, which may lie in the apron
+static S32 program_operand(V2S dimensions, V2S point)
+{
+  return (S32) MODEL_OFFSET(dimensions, point.x, point.y);
+}
+
+// memory offset of an output, or INDEX_NONE off the grid
+static S32 program_output(V2S dimensions, V2S point)
+{
+  return valid_point(dimensions, point) ? (S32) MODEL_OFFSET(dimensions, point.x, point.y) : INDEX_NONE;
+}
+
+static Instruction program_instruction(V2S dimensions, Index x, Index y, ValueTag tag)
+{
+  const V2S origin = { (S32) x, (S32) y };
+  Instruction in = {
+    .input = { INDEX_NONE, INDEX_NONE, INDEX_NONE },
+    .output = INDEX_NONE,
+    .x = (U16) x,
+    .y = (U16) y,
+    .tag = (U8) tag,
+  };
+
+  // Offsets mirror the reads and writes in `model_step_tile`. Operators
+  // without operands here only pulse. Interference and multiplexing list
+  // their fixed operands, for the partition, but are evaluated by the
+  // interpreter.
+  switch (tag) {
+    case VALUE_ALTER:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(3, 0)));
+      in.input[1] = program_operand(dimensions, v2s_sub(origin, v2s(2, 0)));
+      in.input[2] = program_operand(dimensions, v2s_sub(origin, v2s(1, 0)));
+      in.output   = program_output(dimensions, v2s_add(origin, v2s(0, 1)));
+      break;
+    case VALUE_HOP:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(1, 0)));
+      in.output   = program_output(dimensions, v2s_add(origin, v2s(1, 0)));
+      break;
+    case VALUE_JUMP:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(0, 1)));
+      in.output   = program_output(dimensions, v2s_add(origin, v2s(0, 1)));
+      break;
+    case VALUE_LOAD:
+    case VALUE_NOTE:
+    case VALUE_QUOTE:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(1, 0)));
+      in.output   = program_output(dimensions, v2s_add(origin, v2s(0, 1)));
+      break;
+    case VALUE_INTERFERE:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(3, 0)));
+      in.input[1] = program_operand(dimensions, v2s_sub(origin, v2s(2, 0)));
+      in.input[2] = program_operand(dimensions, v2s_sub(origin, v2s(1, 0)));
+      break;
+    case VALUE_MULTIPLEX:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(2, 0)));
+      in.input[1] = program_operand(dimensions, v2s_sub(origin, v2s(1, 0)));
+      in.output   = program_output(dimensions, v2s_add(origin, v2s(0, 1)));
+      break;
+    case VALUE_SYNTH:
+    case VALUE_WAVE:
+    case VALUE_SAMPLER:
+      break;
+    default:
+      in.input[0] = program_operand(dimensions, v2s_sub(origin, v2s(2, 0)));
+      in.input[1] = program_operand(dimensions, v2s_sub(origin, v2s(1, 0)));
+      in.output   = program_output(dimensions, v2s_add(origin, v2s(0, 1)));
+      break;
+  }
+  return in;
+}
+
+// The partition is a union-find forest over index words and instructions.
+// Roots hold a negative value, which is -1 until the root is given a lane.
+static Index partition_find(Index* partition, Index node)
+{
+  Index root = node;
+  while (partition[root] >= 0) {
+    root = partition[root];
+  }
+  while (partition[node] >= 0) {
+    const Index next = partition[node];
+    partition[node] = root;
+    node = next;
+  }
+  return root;
+}
+
+static Void partition_join(Index* partition, Index a, Index b)
+{
+  const Index ra = partition_find(partition, a);
+  const Index rb = partition_find(partition, b);
+  if (ra != rb) {
+    partition[ra] = rb;
+  }
+}
+
+// Join the index word holding a tile to an operator. Operators that share a
+// tile share its word, so words alone keep apart the operators that must be.
+static Void partition_touch(const Model* m, Index origin, V2S point)
+{
+  if (valid_point(m->dimensions, point)) {
+    const Index word = point.y * m->index->stride + point.x / PLANE_BITS;
+    partition_join(m->program->partition, origin, word);
+  }
+}
+
+// The tiles an operator can reach through an offset taken from cell data.
+// Interference writes at (x, y + 1), and multiplexing reads at (x + 1, -y),
+// for literals x and y.
+static Bool partition_reach(const Instruction* in, V2S* min, V2S* max)
+{
+  const V2S origin = { in->x, in->y };
+  switch (in->tag) {
+    case VALUE_INTERFERE:
+      *min = v2s_add(origin, v2s(0, 1));
+      *max = v2s_add(origin, v2s(MODEL_RADIX - 1, MODEL_RADIX));
+      return true;
+    case VALUE_MULTIPLEX:
+      *min = v2s_add(origin, v2s(1, 1 - MODEL_RADIX));
+      *max = v2s_add(origin, v2s(MODEL_RADIX, 0));
+      return true;
+    default:
+      return false;
+  }
+}
+
+// whether an operator lies in a rectangle, clipped to the grid
+static Bool partition_holds_operator(const Model* m, V2S min, V2S max)
+{
+  const S32 x0 = MAX(min.x, 0);
+  const S32 y0 = MAX(min.y, 0);
+  const S32 x1 = MIN(max.x, (S32) m->dimensions.x - 1);
+  const S32 y1 = MIN(max.y, (S32) m->dimensions.y - 1);
+  for (S32 y = y0; y <= y1; y++) {
+    for (S32 x = x0; x <= x1; x++) {
+      if (is_compiled(MODEL_INDEX(m, x, y))) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Whether an operator can be created or removed during the beat. Otherwise
+// the operators in memory stay put, and so does every footprint.
+static Bool partition_unsafe(const Model* m, const Instruction* in, Bool registers)
+{
+  V2S min, max;
+  switch (in->tag) {
+    case VALUE_QUOTE:
+      return true;
+    case VALUE_LOAD:
+      if (registers) {
+        return true;
+      }
+      break;
+    case VALUE_HOP:
+    case VALUE_JUMP:
+    case VALUE_INTERFERE:
+      // these copy their first operand
+      if (in->input[0] != INDEX_NONE && is_compiled(m->memory[in->input[0]])) {
+        return true;
+      }
+      break;
+    default: { }
+  }
+  if (partition_reach(in, &min, &max) && partition_holds_operator(m, min, max)) {
+    return true;
+  }
+  return in->output != INDEX_NONE && is_compiled(m->memory[in->output]);
+}
+
+// whether the registers can hand an operator to a load
+static Bool partition_registers(const Model* m)
+{
+  const ModelProgram* const program = m->program;
+  for (S32 r = 0; r < MODEL_RADIX; r++) {
+    if (is_compiled(m->register_file->registers[r])) {
+      return true;
+    }
+  }
+  for (Index i = 0; i < program->length; i++) {
+    const Instruction* const in = &program->instructions[i];
+    if (in->tag == VALUE_STORE && in->input[0] != INDEX_NONE && is_compiled(m->memory[in->input[0]])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static Void program_partition(Model* m)
+{
+  ModelProgram* const program = m->program;
+  Index* const partition = program->partition;
+  const Index words = model_index_words(m->dimensions);
+  const Index nodes = words + program->length;
+
+  program->lanes = 0;
+  const Bool registers = partition_registers(m);
+  for (Index i = 0; i < program->length; i++) {
+    if (partition_unsafe(m, &program->instructions[i], registers)) {
+      return;
+    }
+  }
+
+  for (Index i = 0; i < nodes; i++) {
+    partition[i] = -1;
+  }
+
+  // An operator touches its own tile, its operands, and its output. A bang
+  // written to the output updates the adjacency of its neighbours, which
+  // depends on the bangs beside them in turn, so the touch extends two tiles
+  // from the output. An operator with an offset from cell data touches all
+  // the tiles it can reach.
+  for (Index i = 0; i < program->length; i++) {
+    const Instruction* const in = &program->instructions[i];
+    const V2S origin = { in->x, in->y };
+    const Index node = words + i;
+    partition_touch(m, node, origin);
+    for (S32 j = 0; j < 3; j++) {
+      if (in->input[j] != INDEX_NONE) {
+        partition_touch(m, node, model_point(m->dimensions, in->input[j]));
+      }
+    }
+    if (in->output != INDEX_NONE) {
+      // mark the chunk now, so that lanes only read the chunk plane
+      const V2S output = model_point(m->dimensions, in->output);
+      plane_assign(m->index->chunks, m->index->chunk_stride, output.x / MODEL_CHUNK, output.y / MODEL_CHUNK, true);
+      for (S32 dy = -2; dy <= 2; dy++) {
+        for (S32 dx = ABS(dy) - 2; dx <= 2 - ABS(dy); dx++) {
+          partition_touch(m, node, v2s_add(output, v2s(dx, dy)));
+        }
+      }
+    }
+    V2S min, max;
+    if (partition_reach(in, &min, &max)) {
+      const Bool writes = in->tag == VALUE_INTERFERE;
+      const S32 margin = writes ? 2 : 0;
+      const S32 x0 = MAX(min.x - margin, 0);
+      const S32 y0 = MAX(min.y - margin, 0);
+      const S32 x1 = MIN(max.x + margin, (S32) m->dimensions.x - 1);
+      const S32 y1 = MIN(max.y + margin, (S32) m->dimensions.y - 1);
+      for (S32 y = y0; y <= y1; y++) {
+        for (S32 x = x0; x <= x1; x++) {
+          partition_touch(m, node, v2s(x, y));
+          if (writes) {
+            plane_assign(m->index->chunks, m->index->chunk_stride, x / MODEL_CHUNK, y / MODEL_CHUNK, true);
+          }
+        }
+      }
+    }
+  }
+
+  // Sets that share the registers or the random number generator run in the
+  // first lane, as do those with an offset from cell data, whose footprints
+  // are wide. The rest go to the shortest lane when first seen.
+  for (Index l = 0; l < MODEL_LANES; l++) {
+    program->lane_length[l] = 0;
+  }
+  for (Index i = 0; i < program->length; i++) {
+    const Instruction* const in = &program->instructions[i];
+    if (in->tag == VALUE_STORE || in->tag == VALUE_RANDOM || in->tag == VALUE_LOAD || in->tag == VALUE_INTERFERE || in->tag == VALUE_MULTIPLEX) {
+      partition[partition_find(partition, words + i)] = -2;
+    }
+  }
+  for (Index i = 0; i < program->length; i++) {
+    Instruction* const in = &program->instructions[i];
+    const Index root = partition_find(partition, words + i);
+    if (partition[root] == -1) {
+      Index shortest = 0;
+      for (Index l = 1; l < MODEL_LANES; l++) {
+        if (program->lane_length[l] < program->lane_length[shortest]) {
+          shortest = l;
+        }
+      }
+      partition[root] = -2 - shortest;
+    }
+    in->lane = (U8) (-2 - partition[root]);
+    program->lane_length[in->lane] += 1;
+  }
+
+  for (Index l = 0; l < MODEL_LANES; l++) {
+    if (program->lane_length[l] > 0) {
+      program->lanes += 1;
+    }
+  }
+  if (program->lanes < 2) {
+    program->lanes = 0;
+  }
+}
+
+static Void program_compile(Model* m)
+{
+  ModelProgram* const program = m->program;
+  const ModelIndex* const index = m->index;
+  program->length = 0;
+  program->operators = 0;
+  for (Index y = 0; y < m->dimensions.y; y++) {
+    for (Index w = 0; w < index->stride; w++) {
+      U64 pending = index->active[y * index->stride + w];
+      while (pending) {
+        const Index x = w * PLANE_BITS + u64_trailing_zeros(pending);
+        pending &= pending - 1;
+        const Cell cell = MODEL_INDEX(m, x, y);
+        if (is_compiled(cell)) {
+          if (program->operators < program->capacity) {
+            program->instructions[program->operators] = program_instruction(m->dimensions, x, y, cell_tag(cell));
+          }
+          program->operators += 1;
+        }
+      }
+    }
+  }
+
+  // a stream that does not fit is left invalid, and the beat interpreted
+  program->lanes = 0;
+  if (program->operators > program->capacity) {
+    return;
+  }
+  program->length = program->operators;
+  program->valid = true;
+  if (m->pool) {
+    program_partition(m);
+  }
+}
+
+static Value program_load(const Model* m, S32 offset)
+{
+  profile_read(m);
+  return value_of_cell(m->memory[offset]);
+}
+
+static Void program_store(Model* m, const Instruction* in, Value v)
+{
+  if (in->output != INDEX_NONE) {
+    model_set(m, model_point(m->dimensions, in->output), v);
+    profile_write(m);
+  }
+}
+
+// the compiled counterpart of `model_evaluate_tile`
+static Void program_evaluate(Model* m, const Instruction* in)
+{
+  // shorthand
+  RegisterFile* const rf = m->register_file;
+  const ModelIndex* const index = m->index;
+
+  if (in->tag == VALUE_INTERFERE || in->tag == VALUE_MULTIPLEX) {
+    model_evaluate_tile(m, NULL, in->x, in->y);
+    return;
+  }
+
+  Cell* const cell = &MODEL_INDEX(m, in->x, in->y);
+  const Bool powered = cell_powered(*cell);
+  const Bool bang = plane_test(index->adjacent, index->stride, in->x, in->y);
+
+  // mark pulse
+  if (powered == false && bang && cell_pulse(*cell) == false) {
+    cell_assign(m, MODEL_OFFSET(m->dimensions, in->x, in->y), *cell | CELL_PULSE);
+  }
+
+  if (powered || bang) {
+
+    profile_fire(m);
+
+    switch (in->tag) {
+
+      case VALUE_ADD:
+        {
+          const S32 augend = read_literal(program_load(m, in->input[0]), 0);
+          const S32 addend = read_literal(program_load(m, in->input[1]), 0);
+          program_store(m, in, value_literal((augend + addend) % MODEL_RADIX));
+        } break;
+
+      case VALUE_SUB:
+        {
+          const S32 minuend    = read_literal(program_load(m, in->input[0]), 0);
+          const S32 subtrahend = read_literal(program_load(m, in->input[1]), 0);
+          const S32 difference = minuend - subtrahend;
+          program_store(m, in, value_literal(difference < 0 ? difference + MODEL_RADIX : difference));
+        } break;
+
+      case VALUE_MUL:
+        {
+          const S32 multiplier   = read_literal(program_load(m, in->input[0]), 0);
+          const S32 multiplicand = read_literal(program_load(m, in->input[1]), 0);
+          program_store(m, in, value_literal((multiplier * multiplicand) % MODEL_RADIX));
+        } break;
+
+      case VALUE_DIV:
+        {
+          const S32 dividend = read_literal(program_load(m, in->input[0]), 0);
+          const S32 divisor  = read_literal(program_load(m, in->input[1]), 0);
+          program_store(m, in, divisor != 0 ? value_literal(dividend / divisor) : value_none);
+        } break;
+
+      case VALUE_EQUAL:
+      case VALUE_GREATER:
+      case VALUE_LESSER:
+        {
+          const Value lhs = program_load(m, in->input[0]);
+          const Value rhs = program_load(m, in->input[1]);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            const Bool holds
+              = in->tag == VALUE_EQUAL   ? lhs.literal == rhs.literal
+              : in->tag == VALUE_GREATER ? lhs.literal >  rhs.literal
+              :                            lhs.literal <  rhs.literal;
+            if (holds) {
+              program_store(m, in, value_bang);
+            }
+          }
+        } break;
+
+      case VALUE_AND:
+        {
+          const Value lhs = program_load(m, in->input[0]);
+          const Value rhs = program_load(m, in->input[1]);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            program_store(m, in, value_literal(lhs.literal & rhs.literal));
+          } else if (lhs.tag != VALUE_NONE && rhs.tag != VALUE_NONE) {
+            program_store(m, in, value_bang);
+          }
+        } break;
+
+      case VALUE_OR:
+        {
+          const Value lhs = program_load(m, in->input[0]);
+          const Value rhs = program_load(m, in->input[1]);
+          if (lhs.tag == VALUE_LITERAL && rhs.tag == VALUE_LITERAL) {
+            program_store(m, in, value_literal((lhs.literal | rhs.literal) % MODEL_RADIX));
+          } else if (lhs.tag != VALUE_NONE || rhs.tag != VALUE_NONE) {
+            program_store(m, in, value_bang);
+          }
+        } break;
+
+      case VALUE_ALTER:
+        {
+          const S32 tv   = read_literal(program_load(m, in->input[0]), 0);
+          const S32 lhsv = read_literal(program_load(m, in->input[1]), 0);
+          const S32 rhsv = read_literal(program_load(m, in->input[2]), 0);
+          const S32 scale = MODEL_RADIX - 1;
+          program_store(m, in, value_literal(((scale - tv) * lhsv + tv * rhsv) / scale));
+        } break;
+
+      case VALUE_BOTTOM:
+        {
+          const S32 lhs = read_literal(program_load(m, in->input[0]), MODEL_RADIX - 1);
+          const S32 rhs = read_literal(program_load(m, in->input[1]), MODEL_RADIX - 1);
+          program_store(m, in, value_literal(MIN(lhs, rhs)));
+        } break;
+
+      case VALUE_CLOCK:
+        {
+          const S32 rate = read_literal(program_load(m, in->input[0]), 0) + 1;
+          const S32 mod = map_zero(read_literal(program_load(m, in->input[1]), 0), MODEL_RADIX);
+          model_frame_period(m, rate * mod);
+          if (rf->frame % rate == 0) {
+            program_store(m, in, value_literal((rf->frame / rate) % mod));
+          }
+        } break;
+
+      case VALUE_DELAY:
+        {
+          const S32 rate = read_literal(program_load(m, in->input[0]), 0) + 1;
+          const S32 mod = map_zero(read_literal(program_load(m, in->input[1]), 1), MODEL_RADIX);
+          model_frame_period(m, rate * mod);
+          if ((rf->frame / rate) % mod == 0) {
+            program_store(m, in, value_bang);
+          }
+        } break;
+
+      case VALUE_HOP:
+      case VALUE_JUMP:
+        {
+          program_store(m, in, program_load(m, in->input[0]));
+        } break;
+
+      case VALUE_LOAD:
+        {
+          const Value reg = program_load(m, in->input[0]);
+          if (reg.tag == VALUE_LITERAL) {
+            program_store(m, in, value_of_cell(rf->registers[reg.literal]));
+          } else {
+            program_store(m, in, value_none);
+          }
+        } break;
+
+      case VALUE_NOTE:
+        {
+          const S32 index = read_literal(program_load(m, in->input[0]), 0);
+          const S32 octave  = index / SCALE_CARDINAL;
+          const S32 note    = index % SCALE_CARDINAL;
+          program_store(m, in, value_literal((OCTAVE * octave + scale_table[note]) % MODEL_RADIX));
+        } break;
+
+      case VALUE_ODDMENT:
+        {
+          const S32 dividend = read_literal(program_load(m, in->input[0]), 0);
+          const S32 divisor = map_zero(read_literal(program_load(m, in->input[1]), 0), MODEL_RADIX);
+          program_store(m, in, value_literal(dividend % divisor));
+        } break;
+
+      case VALUE_QUOTE:
+        {
+          const Value index = program_load(m, in->input[0]);
+          const Value output = {
+            .tag = index.tag == VALUE_LITERAL ? VALUE_BANG + index.literal : VALUE_NONE,
+            .powered = true,
+          };
+          program_store(m, in, quotation_table[output.tag] ? output : value_none);
+        } break;
+
+      case VALUE_RANDOM:
+        {
+          const S32 rate = read_literal(program_load(m, in->input[0]), 0) + 1;
+          model_frame_period(m, rate);
+          if (rf->frame % rate == 0) {
+            const S32 mod = map_zero(read_literal(program_load(m, in->input[1]), 0), MODEL_RADIX);
+            program_store(m, in, value_literal(register_random(rf) % mod));
+          }
+        } break;
+
+      case VALUE_STORE:
+        {
+          const Value set = program_load(m, in->input[0]);
+          const Value reg = program_load(m, in->input[1]);
+          if (reg.tag == VALUE_LITERAL) {
+            register_assign(rf, reg.literal, cell_of_value(set));
+          }
+        } break;
+
+      case VALUE_TOP:
+        {
+          const S32 lhs = read_literal(program_load(m, in->input[0]), 0);
+          const S32 rhs = read_literal(program_load(m, in->input[1]), 0);
+          program_store(m, in, value_literal(MAX(lhs, rhs)));
+        } break;
+
+      default: { }
+    }
+  }
+}
+
+static Void program_execute(Model* m, const Instruction* in)
+{
+  if (m->profile) {
+    const U64 begin = profile_begin(m, in->x, in->y);
+    program_evaluate(m, in);
+    profile_end(m, begin);
+  } else {
+    program_evaluate(m, in);
+  }
+}
+
+// visit deferred bangs that precede a tile
+static Void program_flush(Model* m, Index until)
+{
+  ModelProgram* const program = m->program;
+  const ModelIndex* const index = m->index;
+  while (program->pending_head < program->pending_length) {
+    const Index i = program->pending[program->pending_head];
+    if (i >= until) {
+      break;
+    }
+    program->pending_head += 1;
+    program->cursor = i;
+    const V2S point = model_point(m->dimensions, i);
+    if (plane_test(index->active, index->stride, point.x, point.y)) {
+      model_step_tile(m, NULL, point.x, point.y);
+    }
+  }
+}
+
+// A lane evaluates on its own view of the model. The first lane owns the
+// register file. The others start from a copy with a zero hash, so that each
+// accumulates the change to the hash from its own writes. Lanes never share a
+// tile, but they do share tags, so each counts tags in a profile of its own.
+typedef struct ModelLane {
+  Model model;
+  RegisterFile register_file;
+  ModelProgram program;
+  Index frame_period;
+  ModelProfile profile;
+} ModelLane;
+
+static Void program_lane(Void* arg, Index lane)
+{
+  ModelLane* const view = &((ModelLane*) arg)[lane];
+  Model* const m = &view->model;
+  ModelProgram* const program = m->program;
+  const Index cells = MODEL_CELLS(m->dimensions);
+
+  for (Index i = 0; i < program->length; i++) {
+    const Instruction* const in = &program->instructions[i];
+    if (in->lane == lane) {
+      const Index origin = MODEL_OFFSET(m->dimensions, in->x, in->y);
+      program_flush(m, origin);
+      program->cursor = origin;
+      program_execute(m, in);
+      ASSERT(program->valid);
+    }
+  }
+
+  program_flush(m, cells);
+  program->cursor = cells;
+}
+
+static Void program_run_lanes(Model* m)
+{
+  const ModelProgram* const program = m->program;
+  ModelLane lanes[MODEL_LANES];
+
+  // lanes share the profile's table, so their tiles are added beforehand
+  if (m->profile) {
+    for (Index i = 0; i < program->length; i++) {
+      const Instruction* const in = &program->instructions[i];
+      profile_slot(m->profile, in->y * m->dimensions.x + in->x);
+    }
+  }
+
+  // each lane defers bangs into its own part of the pending buffer
+  Index base = 0;
+  for (Index l = 0; l < MODEL_LANES; l++) {
+    ModelLane* const view = &lanes[l];
+    view->model = *m;
+    view->model.program = &view->program;
+    view->program = *program;
+    view->program.pending = &program->pending[base];
+    base += program->lane_length[l];
+    if (l > 0) {
+      view->register_file = *m->register_file;
+      view->register_file.hash = 0;
+      view->model.register_file = &view->register_file;
+    }
+    if (m->frame_period) {
+      view->frame_period = *m->frame_period;
+      view->model.frame_period = &view->frame_period;
+    }
+    if (m->profile) {
+      view->profile = *m->profile;
+      view->profile.shared = true;
+      memset(view->profile.tags, 0, sizeof(view->profile.tags));
+      view->model.profile = &view->profile;
+    }
+  }
+
+  m->pool->run(m->pool->context, program_lane, lanes, MODEL_LANES);
+
+  // merge the lanes, whose effects commute
+  for (Index l = 0; l < MODEL_LANES; l++) {
+    if (l > 0) {
+      m->register_file->hash ^= lanes[l].register_file.hash;
+    }
+    if (m->frame_period) {
+      model_frame_period(m, lanes[l].frame_period);
+    }
+    if (m->profile) {
+      for (Index t = 0; t < VALUE_CARDINAL; t++) {
+        ProfileCounter* const sum = &m->profile->tags[t];
+        const ProfileCounter* const part = &lanes[l].profile.tags[t];
+        sum->fires += part->fires;
+        sum->reads += part->reads;
+        sum->writes += part->writes;
+        sum->ticks += part->ticks;
+      }
+    }
+  }
+  m->program->cursor = MODEL_CELLS(m->dimensions);
+}
+
+static Void program_run(Model* m)
+{
+  ModelProgram* const program = m->program;
+  const Index cells = MODEL_CELLS(m->dimensions);
+
+  program->cursor = INDEX_NONE;
+  program->pending_head = 0;
+  program->pending_length = 0;
+  if (program->valid == false) {
+    program_compile(m);
+  }
+  if (program->valid == false) {
+    program->cursor = cells;
+    model_step_from(m, NULL, 0, 0);
+    return;
+  }
+
+  if (m->pool && program->lanes > 0) {
+    program_run_lanes(m);
+    return;
+  }
+
+  for (Index i = 0; i < program->length; i++) {
+    const Instruction* const in = &program->instructions[i];
+    const Index origin = MODEL_OFFSET(m->dimensions, in->x, in->y);
+    program_flush(m, origin);
+    program->cursor = origin;
+    program_execute(m, in);
+
+    // once an operator has moved, the rest of the stream may be stale
+    if (program->valid == false) {
+      program->cursor = cells;
+      model_step_from(m, NULL, in->x + 1, in->y);
+      return;
+    }
+  }
+
+  program_flush(m, cells);
+  program->cursor = cells;
+}
+
+static Bool is_sounding(ValueTag tag)
+{
+  return tag == VALUE_SYNTH || tag == VALUE_WAVE || tag == VALUE_SAMPLER || tag == VALUE_MIDI;
+}
+
+static Void event_record(const Model* m, EventSink* sink, Index x, Index y)
+{
+  const Cell cell = MODEL_INDEX(m, x, y);
+  if (is_sounding(cell_tag(cell)) == false) {
+    return;
+  }
+  if (sink->head == sink->capacity) {
+    sink->dropped += 1;
+    return;
+  }
+  ModelEvent* const event = &sink->events[sink->head];
+  event->frame = m->register_file->frame - 1;
+  event->origin = v2s((S32) x, (S32) y);
+  event->tag = cell_tag(cell);
+  for (S32 i = 0; i < EVENT_OPERANDS; i++) {
+    event->operands[i] = MODEL_INDEX(m, x - i - 1, y) & ~CELL_PULSE;
+  }
+  sink->head += 1;
+}
+
+// record the events of the beat just evaluated, in reading order
+static Void event_collect(const Model* m, EventSink* sink)
+{
+  const ModelIndex* const index = m->index;
+  if (index) {
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      for (Index w = 0; w < index->stride; w++) {
+        const Index i = y * index->stride + w;
+        U64 pending = index->active[i] & index->adjacent[i];
+        while (pending) {
+          const Index x = w * PLANE_BITS + u64_trailing_zeros(pending);
+          pending &= pending - 1;
+          event_record(m, sink, x, y);
+        }
+      }
+    }
+  } else {
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      for (Index x = 0; x < m->dimensions.x; x++) {
+        if (is_sounding(cell_tag(MODEL_INDEX(m, x, y)))) {
+          Bool bang = false;
+          for (Direction d = 0; d < DIRECTION_CARDINAL; d++) {
+            const Value adjacent = model_peek(m, add_unit_vector(v2s((S32) x, (S32) y), d));
+            bang = bang || adjacent.tag == VALUE_BANG;
+          }
+          if (bang) {
+            event_record(m, sink, x, y);
+          }
+        }
+      }
+    }
+  }
+}
+
+Void model_step(Model* m, Graph* g, EventSink* events)
+{
+  // Only the recorded prefix of the edge buffer is meaningful, so resetting
+  // the head clears the graph.
+  if (g) {
+    g->head = 0;
+  }
+
+  // shorthand
+  RegisterFile* const rf = m->register_file;
+  ModelIndex* const index = m->index;
+  ModelProfile* const profile = m->profile;
+  const U64 begin = profile && profile->clock ? profile->clock() : 0;
+
+  if (index) {
+
+    // clear bangs and pulses
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      for (Index w = 0; w < index->stride; w++) {
+        U64* const word = &index->active[y * index->stride + w];
+        U64 pending = *word;
+        while (pending) {
+          const S32 bit = u64_trailing_zeros(pending);
+          pending &= pending - 1;
+          const Index i = MODEL_OFFSET(m->dimensions, w * PLANE_BITS + bit, y);
+          const Cell cell = m->memory[i];
+          if (cell_tag(cell) == VALUE_BANG) {
+            cell_assign(m, i, 0);
+            *word &= ~(((U64) 1) << bit);
+          } else if (cell_pulse(cell)) {
+            cell_assign(m, i, cell & ~CELL_PULSE);
+          }
+        }
+      }
+    }
+
+    // with every bang gone, nothing is adjacent to one
+    const Index words = model_index_words(m->dimensions);
+    memset(index->bangs, 0, words * sizeof(U64));
+    memset(index->adjacent, 0, words * sizeof(U64));
+
+    // The instruction stream does not record edges, so graph recording
+    // always goes through the interpreter.
+    if (m->program && g == NULL) {
+      program_run(m);
+    } else {
+      model_step_from(m, g, 0, 0);
+    }
+
+  } else {
+
+    // clear bangs and pulses
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      for (Index x = 0; x < m->dimensions.x; x++) {
+        const Index i = MODEL_OFFSET(m->dimensions, x, y);
+        const Cell cell = m->memory[i];
+        if (cell_tag(cell) == VALUE_BANG) {
+          cell_assign(m, i, 0);
+        } else if (cell_pulse(cell)) {
+          cell_assign(m, i, cell & ~CELL_PULSE);
+        }
+      }
+    }
+
+    // iterate in English reading order
+    for (Index y = 0; y < m->dimensions.y; y++) {
+      for (Index x = 0; x < m->dimensions.x; x++) {
+        model_step_tile(m, g, x, y);
+      }
+    }
+
+  }
+
+  rf->frame += 1;
+
+  if (profile) {
+    profile->beats += 1;
+    if (profile->clock) {
+      profile->ticks += profile->clock() - begin;
+    }
+  }
+
+  // the adjacency plane is final once every tile has been visited
+  if (events) {
+    event_collect(m, events);
+  }
+}
+
+Void model_profile_clear(ModelProfile* profile)
+{
+  profile->beats = 0;
+  profile->ticks = 0;
+  memset(profile->tags, 0, sizeof(profile->tags));
+  profile->length = 0;
+  for (Index i = 0; i < profile->capacity; i++) {
+    profile->tiles[i] = INDEX_NONE;
+  }
+  memset(profile->cells, 0, profile->capacity * sizeof(ProfileCounter));
+  profile->tile = NULL;
+  profile->tag = NULL;
+}
+
+Index model_operators(const Model* m)
+{
+  Index operators = 0;
+  for (Index y = 0; y < m->dimensions.y; y++) {
+    for (Index x = 0; x < m->dimensions.x; x++) {
+      operators += is_compiled(MODEL_INDEX(m, x, y));
+    }
+  }
+  return operators;
+}
+
+Void model_step_n(Model* m, Index n, EventSink* sink)
+{
+  for (Index i = 0; i < n; i++) {
+    model_step(m, NULL, sink);
+  }
+}
+
+Void model_graph(const Model* m, Cell* scratch, Graph* graph)
+{
+  // evaluate a throwaway copy, leaving the original program untouched
+  RegisterFile rf = *m->register_file;
+  memcpy(scratch, m->memory, MODEL_CELLS(m->dimensions) * sizeof(Cell));
+  Model copy = {
+    .dimensions = m->dimensions,
+    .register_file = &rf,
+    .memory = scratch,
+    .index = NULL,
+  };
+  model_step(&copy, graph, NULL);
+}
+
+// The cells of every variant at one memory offset. The passes below run over
+// all MODEL_BATCH variants with no early exit, one U16x8 lane per variant, and
+// each write is masked by a per-variant condition.
+_Static_assert(MODEL_BATCH == 8, "a batch tile should fill one U16x8");
+
+static Cell* batch_cells(const ModelBatch* batch, Index offset)
+{
+  return &batch->memory[offset * MODEL_BATCH];
+}
+
+static U16x8 batch_load(const ModelBatch* batch, Index offset)
+{
+  return u16x8_load(batch_cells(batch, offset));
+}
+
+// lanes set where a cell holds `tag`
+static U16x8 batch_is(U16x8 cells, ValueTag tag)
+{
+  return u16x8_eq(u16x8_and(cells, u16x8_splat(CELL_TAG_MASK)), u16x8_splat((U16) tag));
+}
+
+static U16x8 batch_literals(U16x8 cells, S32 none)
+{
+  return u16x8_select(batch_is(cells, VALUE_LITERAL), u16x8_shr(cells, CELL_LITERAL_SHIFT), u16x8_splat((U16) none));
+}
+
+static U16x8 batch_literal_cells(U16x8 literals)
+{
+  return u16x8_or(u16x8_shl(literals, CELL_LITERAL_SHIFT), u16x8_splat(VALUE_LITERAL));
+}
+
+static S32 batch_literal(Cell cell, S32 none)
+{
+  return cell_tag(cell) == VALUE_LITERAL ? cell_literal(cell) : none;
+}
+
+static Cell batch_literal_cell(S32 literal)
+{
+  return (Cell) (VALUE_LITERAL | (literal << CELL_LITERAL_SHIFT));
+}
+
+// `x % MODEL_RADIX`, for x below twice the radix
+static U16x8 batch_wrap(U16x8 x)
+{
+  const U16x8 over = u16x8_gt(x, u16x8_splat(MODEL_RADIX - 1));
+  return u16x8_sub(x, u16x8_and(over, u16x8_splat(MODEL_RADIX)));
+}
+
+// `x / d` as a multiply by the rounded up reciprocal, exact for x up to
+// (MODEL_RADIX - 1) squared
+static U16x8 batch_divide(U16x8 x, U16 d)
+{
+  return u16x8_mulhi(x, u16x8_splat((U16) ((0x10000 + d - 1) / d)));
+}
+
+static Cell batch_mask(Bool condition)
+{
+  return condition ? 0xFFFF : 0;
+}
+
+// variants with a bang on any side of a tile
+static U16x8 batch_adjacent(const ModelBatch* batch, Index offset)
+{
+  const Index stride = MODEL_STRIDE(batch->dimensions);
+  const U16x8 north = batch_is(batch_load(batch, offset - stride), VALUE_BANG);
+  const U16x8 south = batch_is(batch_load(batch, offset + stride), VALUE_BANG);
+  const U16x8 west = batch_is(batch_load(batch, offset - 1), VALUE_BANG);
+  const U16x8 east = batch_is(batch_load(batch, offset + 1), VALUE_BANG);
+  return u16x8_or(u16x8_or(north, south), u16x8_or(west, east));
+}
+
+// whether an operator to the north or west writes to a tile
+static Bool batch_written(const Model* m, Index x, Index y)
+{
+  const Index offset = MODEL_OFFSET(m->dimensions, x, y);
+  const V2S sources[] = { { (S32) x, (S32) y - 1 }, { (S32) x - 1, (S32) y } };
+  for (Index i = 0; i < 2; i++) {
+    const V2S source = sources[i];
+    if (valid_point(m->dimensions, source)) {
+      const Cell cell = MODEL_INDEX(m, source.x, source.y);
+      if (is_compiled(cell)) {
+        const Instruction in = program_instruction(m->dimensions, source.x, source.y, cell_tag(cell));
+        if (in.output == offset) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+// the lockstep counterpart of `program_evaluate`, or a visit to a bang
+static Void batch_execute(ModelBatch* batch, const Instruction* in)
+{
+  const Index offset = MODEL_OFFSET(batch->dimensions, in->x, in->y);
+  Cell* const origin = batch_cells(batch, offset);
+  const U16x8 zero = u16x8_splat(0);
+  const U16x8 radix = u16x8_splat(MODEL_RADIX);
+
+  // mark pulse
+  const U16x8 cells = u16x8_load(origin);
+  const U16x8 bang = batch_adjacent(batch, offset);
+  const U16x8 powered = u16x8_eq(u16x8_and(cells, u16x8_splat(CELL_POWERED)), u16x8_splat(CELL_POWERED));
+  const U16x8 active = u16x8_gt(u16x8_and(cells, u16x8_splat(CELL_TAG_MASK)), u16x8_splat(VALUE_LITERAL));
+  const U16x8 pulse = u16x8_and(u16x8_select(powered, zero, bang), active);
+  u16x8_store(origin, u16x8_or(cells, u16x8_and(pulse, u16x8_splat(CELL_PULSE))));
+  const U16x8 fire = u16x8_or(powered, bang);
+
+  if (in->tag == VALUE_BANG) {
+    return;
+  }
+
+  const Cell* const a = in->input[0] != INDEX_NONE ? batch_cells(batch, in->input[0]) : NULL;
+  const Cell* const b = in->input[1] != INDEX_NONE ? batch_cells(batch, in->input[1]) : NULL;
+  const Cell* const c = in->input[2] != INDEX_NONE ? batch_cells(batch, in->input[2]) : NULL;
+
+  // Operators that divide by an operand, look up a table, or touch the
+  // register file of a variant go lane by lane through these.
+  Cell fired[MODEL_BATCH];
+  Cell lane_value[MODEL_BATCH] = { 0 };
+  Cell lane_write[MODEL_BATCH] = { 0 };
+  u16x8_store(fired, fire);
+
+  U16x8 value = zero;
+  U16x8 write = zero;
+
+  switch (in->tag) {
+
+    case VALUE_ADD:
+      {
+        const U16x8 sum = u16x8_add(batch_literals(u16x8_load(a), 0), batch_literals(u16x8_load(b), 0));
+        value = batch_literal_cells(batch_wrap(sum));
+        write = fire;
+      } break;
+
+    case VALUE_SUB:
+      {
+        const U16x8 lhs = batch_literals(u16x8_load(a), 0);
+        const U16x8 rhs = batch_literals(u16x8_load(b), 0);
+        const U16x8 borrow = u16x8_and(u16x8_gt(rhs, lhs), radix);
+        value = batch_literal_cells(u16x8_sub(u16x8_add(lhs, borrow), rhs));
+        write = fire;
+      } break;
+
+    case VALUE_MUL:
+      {
+        const U16x8 product = u16x8_mul(batch_literals(u16x8_load(a), 0), batch_literals(u16x8_load(b), 0));
+        const U16x8 quotient = batch_divide(product, MODEL_RADIX);
+        value = batch_literal_cells(u16x8_sub(product, u16x8_mul(quotient, radix)));
+        write = fire;
+      } break;
+
+    case VALUE_DIV:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          const S32 dividend = batch_literal(a[l], 0);
+          const S32 divisor = batch_literal(b[l], 0);
+          lane_value[l] = divisor != 0 ? batch_literal_cell(dividend / divisor) : 0;
+          lane_write[l] = fired[l];
+        }
+      } break;
+
+    case VALUE_EQUAL:
+    case VALUE_GREATER:
+    case VALUE_LESSER:
+      {
+        const U16x8 lhs = u16x8_load(a);
+        const U16x8 rhs = u16x8_load(b);
+        const U16x8 literals = u16x8_and(batch_is(lhs, VALUE_LITERAL), batch_is(rhs, VALUE_LITERAL));
+        const U16x8 x = u16x8_shr(lhs, CELL_LITERAL_SHIFT);
+        const U16x8 y = u16x8_shr(rhs, CELL_LITERAL_SHIFT);
+        const U16x8 holds
+          = in->tag == VALUE_EQUAL   ? u16x8_eq(x, y)
+          : in->tag == VALUE_GREATER ? u16x8_gt(x, y)
+          :                            u16x8_gt(y, x);
+        value = u16x8_splat(VALUE_BANG);
+        write = u16x8_and(fire, u16x8_and(literals, holds));
+      } break;
+
+    case VALUE_AND:
+    case VALUE_OR:
+      {
+        const U16x8 lhs = u16x8_load(a);
+        const U16x8 rhs = u16x8_load(b);
+        const U16x8 tags = u16x8_splat(CELL_TAG_MASK);
+        const U16x8 present_lhs = u16x8_gt(u16x8_and(lhs, tags), zero);
+        const U16x8 present_rhs = u16x8_gt(u16x8_and(rhs, tags), zero);
+        const U16x8 literals = u16x8_and(batch_is(lhs, VALUE_LITERAL), batch_is(rhs, VALUE_LITERAL));
+        const U16x8 x = u16x8_shr(lhs, CELL_LITERAL_SHIFT);
+        const U16x8 y = u16x8_shr(rhs, CELL_LITERAL_SHIFT);
+        const U16x8 bits
+          = in->tag == VALUE_AND
+          ? u16x8_and(x, y)
+          : batch_wrap(u16x8_or(x, y));
+        const U16x8 present
+          = in->tag == VALUE_AND
+          ? u16x8_and(present_lhs, present_rhs)
+          : u16x8_or(present_lhs, present_rhs);
+        value = u16x8_select(literals, batch_literal_cells(bits), u16x8_splat(VALUE_BANG));
+        write = u16x8_and(fire, present);
+      } break;
+
+    case VALUE_ALTER:
+      {
+        const U16x8 scale = u16x8_splat(MODEL_RADIX - 1);
+        const U16x8 tv = batch_literals(u16x8_load(a), 0);
+        const U16x8 lhsv = batch_literals(u16x8_load(b), 0);
+        const U16x8 rhsv = batch_literals(u16x8_load(c), 0);
+        const U16x8 mix = u16x8_add(u16x8_mul(u16x8_sub(scale, tv), lhsv), u16x8_mul(tv, rhsv));
+        value = batch_literal_cells(batch_divide(mix, MODEL_RADIX - 1));
+        write = fire;
+      } break;
+
+    case VALUE_BOTTOM:
+      {
+        const U16x8 lhs = batch_literals(u16x8_load(a), MODEL_RADIX - 1);
+        const U16x8 rhs = batch_literals(u16x8_load(b), MODEL_RADIX - 1);
+        value = batch_literal_cells(u16x8_min(lhs, rhs));
+        write = fire;
+      } break;
+
+    case VALUE_TOP:
+      {
+        const U16x8 lhs = batch_literals(u16x8_load(a), 0);
+        const U16x8 rhs = batch_literals(u16x8_load(b), 0);
+        value = batch_literal_cells(u16x8_max(lhs, rhs));
+        write = fire;
+      } break;
+
+    case VALUE_CLOCK:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          const Index frame = batch->register_files[l].frame;
+          const S32 rate = batch_literal(a[l], 0) + 1;
+          const S32 mod = map_zero(batch_literal(b[l], 0), MODEL_RADIX);
+          lane_value[l] = batch_literal_cell((S32) ((frame / rate) % mod));
+          lane_write[l] = fired[l] & batch_mask(frame % rate == 0);
+        }
+      } break;
+
+    case VALUE_DELAY:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          const Index frame = batch->register_files[l].frame;
+          const S32 rate = batch_literal(a[l], 0) + 1;
+          const S32 mod = map_zero(batch_literal(b[l], 1), MODEL_RADIX);
+          lane_value[l] = VALUE_BANG;
+          lane_write[l] = fired[l] & batch_mask((frame / rate) % mod == 0);
+        }
+      } break;
+
+    case VALUE_HOP:
+    case VALUE_JUMP:
+      {
+        value = u16x8_load(a);
+        write = fire;
+      } break;
+
+    case VALUE_NOTE:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          const S32 index = batch_literal(a[l], 0);
+          const S32 octave = index / SCALE_CARDINAL;
+          const S32 note = index % SCALE_CARDINAL;
+          lane_value[l] = batch_literal_cell((OCTAVE * octave + scale_table[note]) % MODEL_RADIX);
+          lane_write[l] = fired[l];
+        }
+      } break;
+
+    case VALUE_ODDMENT:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          const S32 dividend = batch_literal(a[l], 0);
+          const S32 divisor = map_zero(batch_literal(b[l], 0), MODEL_RADIX);
+          lane_value[l] = batch_literal_cell(dividend % divisor);
+          lane_write[l] = fired[l];
+        }
+      } break;
+
+    // Each variant draws from its own generator.
+    case VALUE_RANDOM:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          RegisterFile* const rf = &batch->register_files[l];
+          const S32 rate = batch_literal(a[l], 0) + 1;
+          if (fired[l] && rf->frame % rate == 0) {
+            const S32 mod = map_zero(batch_literal(b[l], 0), MODEL_RADIX);
+            lane_value[l] = batch_literal_cell((S32) (rnd_pcg_next(&rf->rnd) % (U32) mod));
+            lane_write[l] = batch_mask(true);
+          }
+        }
+      } break;
+
+    case VALUE_STORE:
+      {
+        for (Index l = 0; l < MODEL_BATCH; l++) {
+          if (fired[l] && cell_tag(b[l]) == VALUE_LITERAL) {
+            batch->register_files[l].registers[cell_literal(b[l])] = a[l];
+          }
+        }
+      } break;
+
+    default: { }
+  }
+
+  if (in->output != INDEX_NONE) {
+    value = u16x8_or(value, u16x8_load(lane_value));
+    write = u16x8_or(write, u16x8_load(lane_write));
+    Cell* const out = batch_cells(batch, in->output);
+    u16x8_store(out, u16x8_select(write, value, u16x8_load(out)));
+  }
+}
+
+// record the events of the beat just evaluated, in reading order
+static Void batch_events(const ModelBatch* batch, EventSink* sinks)
+{
+  for (Index i = 0; i < batch->length; i++) {
+    const Instruction* const in = &batch->stream[i];
+    if (is_sounding(in->tag) == false) {
+      continue;
+    }
+    const Index offset = MODEL_OFFSET(batch->dimensions, in->x, in->y);
+    Cell bang[MODEL_BATCH];
+    u16x8_store(bang, batch_adjacent(batch, offset));
+    for (Index l = 0; l < batch->variants; l++) {
+      EventSink* const sink = &sinks[l];
+      if (bang[l] == 0) {
+        continue;
+      }
+      if (sink->head == sink->capacity) {
+        sink->dropped += 1;
+        continue;
+      }
+      ModelEvent* const event = &sink->events[sink->head];
+      event->frame = batch->register_files[l].frame - 1;
+      event->origin = v2s(in->x, in->y);
+      event->tag = in->tag;
+      for (S32 j = 0; j < EVENT_OPERANDS; j++) {
+        event->operands[j] = batch_cells(batch, offset - j - 1)[l] & ~CELL_PULSE;
+      }
+      sink->head += 1;
+    }
+  }
+}
+
+// Operators that can write an operator, or use offsets from cell data. The
+// variants of a batch differ in data, so these would tell them apart.
+static Bool batch_unsafe(const Model* m, const Instruction* in)
+{
+  switch (in->tag) {
+    case VALUE_INTERFERE:
+    case VALUE_MULTIPLEX:
+    case VALUE_QUOTE:
+    case VALUE_LOAD:
+      return true;
+    case VALUE_HOP:
+    case VALUE_JUMP:
+      if (is_compiled(m->memory[in->input[0]])) {
+        return true;
+      }
+      break;
+    default: { }
+  }
+  return in->output != INDEX_NONE && is_compiled(m->memory[in->output]);
+}
+
+Index model_batch_conflict(const Model* m)
+{
+  for (Index y = 0; y < m->dimensions.y; y++) {
+    for (Index x = 0; x < m->dimensions.x; x++) {
+      const Cell cell = MODEL_INDEX(m, x, y);
+      if (is_compiled(cell)) {
+        const Instruction in = program_instruction(m->dimensions, x, y, cell_tag(cell));
+        if (batch_unsafe(m, &in)) {
+          return MODEL_OFFSET(m->dimensions, x, y);
+        }
+      }
+    }
+  }
+  return INDEX_NONE;
+}
+
+Bool model_batch_load(ModelBatch* batch, const Model* variants, Index count)
+{
+  ASSERT(count > 0 && count <= MODEL_BATCH);
+  const Model* const base = &variants[0];
+  const V2S d = base->dimensions;
+  if (model_batch_conflict(base) != INDEX_NONE) {
+    return false;
+  }
+
+  // every variant has the operators of the first
+  const Index cells = MODEL_CELLS(d);
+  for (Index v = 1; v < count; v++) {
+    if (v2s_equal(variants[v].dimensions, d) == false) {
+      return false;
+    }
+    for (Index i = 0; i < cells; i++) {
+      const Cell p = base->memory[i];
+      const Cell q = variants[v].memory[i];
+      if (is_compiled(p) != is_compiled(q) || (is_compiled(p) && cell_tag(p) != cell_tag(q))) {
+        return false;
+      }
+    }
+  }
+
+  // operators, and the tiles they write, in reading order
+  batch->dimensions = d;
+  batch->variants = count;
+  batch->length = 0;
+  for (Index y = 0; y < d.y; y++) {
+    for (Index x = 0; x < d.x; x++) {
+      const Cell cell = MODEL_INDEX(base, x, y);
+      if (is_compiled(cell)) {
+        batch->stream[batch->length] = program_instruction(d, x, y, cell_tag(cell));
+        batch->length += 1;
+      } else if (batch_written(base, x, y)) {
+        batch->stream[batch->length] = program_instruction(d, x, y, VALUE_BANG);
+        batch->length += 1;
+      }
+    }
+  }
+
+  // interleave
+  for (Index i = 0; i < cells; i++) {
+    Cell* const out = batch_cells(batch, i);
+    for (Index l = 0; l < MODEL_BATCH; l++) {
+      out[l] = l < count ? variants[l].memory[i] : 0;
+    }
+  }
+  for (Index l = 0; l < MODEL_BATCH; l++) {
+    if (l < count) {
+      batch->register_files[l] = *variants[l].register_file;
+    } else {
+      memset(&batch->register_files[l], 0, sizeof(RegisterFile));
+    }
+  }
+  return true;
+}
+
+Void model_batch_step(ModelBatch* batch, EventSink* sinks)
+{
+  // clear bangs and pulses
+  const Index cells = MODEL_CELLS(batch->dimensions);
+  const U16x8 keep = u16x8_splat((U16) ~CELL_PULSE);
+  for (Index i = 0; i < cells; i++) {
+    Cell* const tile = batch_cells(batch, i);
+    const U16x8 cell = u16x8_load(tile);
+    const U16x8 cleared = u16x8_select(batch_is(cell, VALUE_BANG), u16x8_splat(0), u16x8_and(cell, keep));
+    u16x8_store(tile, cleared);
+  }
+
+  for (Index i = 0; i < batch->length; i++) {
+    batch_execute(batch, &batch->stream[i]);
+  }
+
+  for (Index l = 0; l < MODEL_BATCH; l++) {
+    batch->register_files[l].frame += 1;
+  }
+
+  if (sinks) {
+    batch_events(batch, sinks);
+  }
+}
+
+Void model_batch_store(const ModelBatch* batch, Index variant, Model* m)
+{
+  ASSERT(variant >= 0 && variant < batch->variants);
+  ASSERT(v2s_equal(batch->dimensions, m->dimensions));
+  const Index cells = MODEL_CELLS(m->dimensions);
+  for (Index i = 0; i < cells; i++) {
+    m->memory[i] = batch_cells(batch, i)[variant];
+  }
+  *m->register_file = batch->register_files[variant];
+  m->register_file->hash = model_hash(m);
+  model_index_rebuild(m);
 }
 
 #define RND_IMPLEMENTATION
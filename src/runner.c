@@ -0,0 +1,621 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL_timer.h>
+#include "sim.h"
+#include "comms.h"
+#include "config.h"
+
+#define RUNNER_DEFAULT_BEATS 0x1000
+
+// audio frames per call to the simulation, as a device might ask for
+#define RUNNER_BLOCK 0x200
+
+// events recorded on a single beat
+#define RUNNER_EVENTS 0x1000
+
+#define EMPTY_CHARACTER '.'
+
+typedef struct RunnerOptions {
+  const Char* paths[SIM_INSTANCES];
+  Index grids;
+  Index beats;
+  S32 tempo;                              // zero for the default
+  Bool dsp;
+  Bool reference;
+  Bool sweep;
+  Bool json;
+} RunnerOptions;
+
+typedef struct Grid {
+  V2S dimensions;
+  Char* rows;                             // dimensions.y rows of dimensions.x
+} Grid;
+
+typedef struct GridReport {
+  F64 model_seconds;
+  Index events;
+  Index dropped;
+  F64 sweep_seconds;                      // zero if the batch refused the grid
+  Index sweep_events;
+  Index conflict;                         // the tile the batch refused, or INDEX_NONE
+} GridReport;
+
+typedef struct RunnerReport {
+  GridReport grids[SIM_INSTANCES];
+  F64 dsp_seconds;
+  Index dsp_frames;
+  Index dsp_blocks;
+  Index published;                        // history slots, over every grid
+} RunnerReport;
+
+// the render thread's side of one instance, which the runner plays
+typedef struct RunnerChannel {
+  ATOMIC_QUEUE_TYPE(Index) allocation_queue;
+  ATOMIC_QUEUE_TYPE(Index) free_queue;
+  ATOMIC_QUEUE_TYPE(Index) profile_queue;
+  ATOMIC_QUEUE_TYPE(Index) profile_free_queue;
+  ATOMIC_QUEUE_TYPE(Index) dsp_queue;
+  ATOMIC_QUEUE_TYPE(Index) dsp_free_queue;
+  ATOMIC_QUEUE_TYPE(ControlMessage) control_queue;
+  ATOMIC_QUEUE_TYPE(ControlMessage) retire_queue;
+  Index allocation_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  Index free_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  Index profile_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  Index profile_free_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  Index dsp_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  Index dsp_free_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  ControlMessage control_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  ControlMessage retire_queue_buffer[MESSAGE_QUEUE_CAPACITY];
+  DSPState dsp_history[SIM_HISTORY];
+  ProgramHistory primary;                 // attached to the instance
+  ProgramHistory secondary;
+  Index render_index;
+  Index render_profile;
+  Index render_dsp;
+  Index published;                        // slots the audio thread published
+} RunnerChannel;
+
+static RunnerChannel runner_channels[SIM_INSTANCES] = {0};
+static ModelEvent runner_event_buffer[RUNNER_EVENTS] = {0};
+static F32 runner_audio[STEREO * RUNNER_BLOCK] = {0};
+
+static Void usage(Void)
+{
+  fprintf(stderr,
+      "usage: runner [options] grid...\n"
+      "  -b, --beats N     beats to evaluate (default %d)\n"
+      "  -t, --tempo N     tempo for the audio simulation\n"
+      "  -d, --dsp         also run the audio simulation for as many beats, with\n"
+      "                    the grids side by side in one rack\n"
+      "  -r, --reference   evaluate with the reference interpreter, without --dsp\n"
+      "  -s, --sweep       also evaluate %d variants of each grid in lockstep, each\n"
+      "                    with its own random seed\n"
+      "  -j, --json        report in JSON\n"
+      "\n"
+      "The grid is a text file with one row per line, written as typed in the\n"
+      "editor, with '.' or ' ' for an empty tile. Lines starting with '#' are\n"
+      "ignored. Up to %d grids may be given.\n",
+      RUNNER_DEFAULT_BEATS,
+      MODEL_BATCH,
+      SIM_INSTANCES);
+}
+
+static Bool parse_options(S32 argc, Char** argv, RunnerOptions* options)
+{
+  options->beats = RUNNER_DEFAULT_BEATS;
+  for (S32 i = 1; i < argc; i++) {
+    const Char* const arg = argv[i];
+    const Bool more = i + 1 < argc;
+    if ((strcmp(arg, "-b") == 0 || strcmp(arg, "--beats") == 0) && more) {
+      options->beats = (Index) strtoll(argv[++i], NULL, 0);
+    } else if ((strcmp(arg, "-t") == 0 || strcmp(arg, "--tempo") == 0) && more) {
+      options->tempo = (S32) strtol(argv[++i], NULL, 0);
+    } else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--dsp") == 0) {
+      options->dsp = true;
+    } else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--reference") == 0) {
+      options->reference = true;
+    } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--sweep") == 0) {
+      options->sweep = true;
+    } else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--json") == 0) {
+      options->json = true;
+    } else if (arg[0] != '-' && options->grids < SIM_INSTANCES) {
+      options->paths[options->grids] = arg;
+      options->grids += 1;
+    } else {
+      return false;
+    }
+  }
+  return options->grids > 0 && options->beats > 0 && options->tempo >= 0;
+}
+
+static Bool valid_character(Char c)
+{
+  const Bool tag = character_tag(c) != VALUE_NONE;
+  return c == EMPTY_CHARACTER || c == ' ' || tag || character_literal(c) >= 0;
+}
+
+static Bool skip_line(const Char* line, Index length)
+{
+  return length == 0 || line[0] == '#';
+}
+
+// read a grid file, padding short rows with empty tiles
+static Bool load_grid(const Char* path, Grid* grid)
+{
+  FILE* const file = fopen(path, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  const Index bytes = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  Char* const text = calloc(bytes + 1, 1);
+  ASSERT(text);
+  const Bool read = (Index) fread(text, 1, bytes, file) == bytes;
+  fclose(file);
+  if (read == false) {
+    fprintf(stderr, "cannot read %s\n", path);
+    free(text);
+    return false;
+  }
+
+  // measure
+  V2S dimensions = {0};
+  for (Char* line = text; line < text + bytes; ) {
+    Char* const end = strchr(line, '\n') ? strchr(line, '\n') : text + bytes;
+    Index length = end - line;
+    if (length > 0 && line[length - 1] == '\r') {
+      length -= 1;
+    }
+    if (skip_line(line, length) == false) {
+      for (Index x = 0; x < length; x++) {
+        if (valid_character(line[x]) == false) {
+          fprintf(stderr, "%s:%d: unknown character '%c'\n", path, dimensions.y + 1, line[x]);
+          free(text);
+          return false;
+        }
+      }
+      dimensions.x = MAX(dimensions.x, (S32) length);
+      dimensions.y += 1;
+    }
+    line = end + 1;
+  }
+  if (dimensions.x == 0 || dimensions.y == 0) {
+    fprintf(stderr, "%s: empty grid\n", path);
+    free(text);
+    return false;
+  }
+
+  // copy
+  grid->dimensions = dimensions;
+  grid->rows = calloc(dimensions.x * dimensions.y, 1);
+  ASSERT(grid->rows);
+  memset(grid->rows, EMPTY_CHARACTER, dimensions.x * dimensions.y);
+  S32 y = 0;
+  for (Char* line = text; line < text + bytes; ) {
+    Char* const end = strchr(line, '\n') ? strchr(line, '\n') : text + bytes;
+    Index length = end - line;
+    if (length > 0 && line[length - 1] == '\r') {
+      length -= 1;
+    }
+    if (skip_line(line, length) == false) {
+      memcpy(&grid->rows[y * dimensions.x], line, length);
+      y += 1;
+    }
+    line = end + 1;
+  }
+
+  free(text);
+  return true;
+}
+
+// operators on the grid, which its program needs room for
+static Index grid_operators(const Grid* grid)
+{
+  Index operators = 0;
+  for (Index i = 0; i < grid->dimensions.x * grid->dimensions.y; i++) {
+    const Char c = grid->rows[i];
+    if (character_tag(c) > VALUE_BANG) {
+      operators += 1;
+    }
+  }
+  return operators;
+}
+
+static Void write_grid(Model* m, const Grid* grid)
+{
+  for (S32 y = 0; y < grid->dimensions.y; y++) {
+    for (S32 x = 0; x < grid->dimensions.x; x++) {
+      const Char c = grid->rows[y * grid->dimensions.x + x];
+      const S32 literal = character_literal(c);
+      if (character_tag(c) != VALUE_NONE) {
+        const Value value = {
+          .tag = character_tag(c),
+          .powered = true,
+        };
+        model_set(m, v2s(x, y), value);
+      } else if (literal >= 0) {
+        model_set(m, v2s(x, y), value_literal(literal));
+      }
+    }
+  }
+}
+
+static F64 seconds_since(U64 begin)
+{
+  const U64 end = SDL_GetPerformanceCounter();
+  return (F64) (end - begin) / (F64) SDL_GetPerformanceFrequency();
+}
+
+// evaluate the grid on its own, as the simulation would on each beat
+static Void run_model(const RunnerOptions* options, const Grid* grid, GridReport* report)
+{
+  ProgramHistory history = sim_allocate_history(1, grid->dimensions, grid_operators(grid));
+  Model model = {
+    .dimensions = history.dimensions,
+    .register_file = history.register_file,
+    .memory = history.memory,
+    .index = options->reference ? NULL : &history.index,
+    .program = options->reference ? NULL : &history.program,
+  };
+  model_init(&model);
+  write_grid(&model, grid);
+
+  EventSink events = { RUNNER_EVENTS, 0, 0, runner_event_buffer };
+  const U64 begin = SDL_GetPerformanceCounter();
+  for (Index beat = 0; beat < options->beats; beat++) {
+    events.head = 0;
+    model_step(&model, NULL, &events);
+    report->events += events.head;
+  }
+  report->model_seconds = seconds_since(begin);
+  report->dropped = events.dropped;
+  sim_free_history(&history);
+}
+
+// evaluate variants of the grid in lockstep, as a parameter sweep would
+static Void run_sweep(const RunnerOptions* options, const Grid* grid, GridReport* report)
+{
+  const V2S dimensions = grid->dimensions;
+  const Index cells = MODEL_CELLS(dimensions);
+  Cell* const memory = calloc(MODEL_BATCH * cells, sizeof(Cell));
+  RegisterFile register_files[MODEL_BATCH];
+  Model variants[MODEL_BATCH];
+  for (Index v = 0; v < MODEL_BATCH; v++) {
+    variants[v] = (Model) {
+      .dimensions = dimensions,
+      .register_file = &register_files[v],
+      .memory = &memory[v * cells],
+    };
+    model_init(&variants[v]);
+    rnd_pcg_seed(&register_files[v].rnd, (U32) v);
+    write_grid(&variants[v], grid);
+  }
+
+  ModelBatch batch = {
+    .memory = calloc(MODEL_BATCH_CELLS(dimensions), sizeof(Cell)),
+    .stream = calloc(MODEL_BATCH_STREAM(dimensions), sizeof(Instruction)),
+  };
+  ASSERT(memory && batch.memory && batch.stream);
+  report->conflict = model_batch_conflict(&variants[0]);
+  if (report->conflict == INDEX_NONE && model_batch_load(&batch, variants, MODEL_BATCH)) {
+    // each variant records its events in a slice of the buffer
+    EventSink sinks[MODEL_BATCH];
+    const Index capacity = RUNNER_EVENTS / MODEL_BATCH;
+    const U64 begin = SDL_GetPerformanceCounter();
+    for (Index beat = 0; beat < options->beats; beat++) {
+      for (Index v = 0; v < MODEL_BATCH; v++) {
+        sinks[v] = (EventSink) { capacity, 0, 0, &runner_event_buffer[v * capacity] };
+      }
+      model_batch_step(&batch, sinks);
+      for (Index v = 0; v < MODEL_BATCH; v++) {
+        report->sweep_events += sinks[v].head;
+      }
+    }
+    report->sweep_seconds = seconds_since(begin);
+  }
+
+  free(batch.stream);
+  free(batch.memory);
+  free(memory);
+}
+
+// give a grid its own instance in the rack, as the editor does for its grid
+static Void attach_grid(const RunnerOptions* options, const Grid* grid, RunnerChannel* c)
+{
+  ATOMIC_QUEUE_INIT(Index)(&c->allocation_queue, c->allocation_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&c->free_queue, c->free_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&c->profile_queue, c->profile_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&c->profile_free_queue, c->profile_free_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&c->dsp_queue, c->dsp_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(Index)(&c->dsp_free_queue, c->dsp_free_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(ControlMessage)(&c->control_queue, c->control_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+  ATOMIC_QUEUE_INIT(ControlMessage)(&c->retire_queue, c->retire_queue_buffer, MESSAGE_QUEUE_CAPACITY);
+
+  c->primary = sim_allocate_history(SIM_HISTORY, grid->dimensions, grid_operators(grid));
+  c->secondary = sim_allocate_secondary(grid->dimensions);
+  Model model = {
+    .dimensions = c->primary.dimensions,
+    .register_file = c->primary.register_file,
+    .memory = c->primary.memory,
+    .index = &c->primary.index,
+    .program = &c->primary.program,
+  };
+  model_init(&model);
+  write_grid(&model, grid);
+
+  const SimChannel channel = {
+    .allocation_queue = &c->allocation_queue,
+    .free_queue = &c->free_queue,
+    .profile_queue = &c->profile_queue,
+    .profile_free_queue = &c->profile_free_queue,
+    .dsp_queue = &c->dsp_queue,
+    .dsp_free_queue = &c->dsp_free_queue,
+    .control_queue = &c->control_queue,
+    .retire_queue = &c->retire_queue,
+    .dsp_history = c->dsp_history,
+  };
+  const Index instance = sim_attach(channel, c->primary, c->secondary);
+  ASSERT(instance != INDEX_NONE);
+
+  c->render_index = 0;
+  c->render_profile = INDEX_NONE;
+  c->render_dsp = 0;
+  c->published = 0;
+  for (Index i = 1; i < SIM_HISTORY; i++) {
+    ATOMIC_QUEUE_ENQUEUE(Index)(&c->free_queue, i);
+    ATOMIC_QUEUE_ENQUEUE(Index)(&c->dsp_free_queue, i);
+  }
+  for (Index i = 1; i < SIM_PROFILES; i++) {
+    ATOMIC_QUEUE_ENQUEUE(Index)(&c->profile_free_queue, i);
+  }
+  if (options->tempo > 0) {
+    ATOMIC_QUEUE_ENQUEUE(ControlMessage)(&c->control_queue, control_message_tempo(options->tempo));
+  }
+}
+
+// take back the slots and windows the audio thread has published
+static Void drain_channel(RunnerChannel* c)
+{
+  while (ATOMIC_QUEUE_LENGTH(Index)(&c->allocation_queue) > 0) {
+    const Index sentinel = -1;
+    const Index message = ATOMIC_QUEUE_DEQUEUE(Index)(&c->allocation_queue, sentinel);
+    ASSERT(message != sentinel);
+    ATOMIC_QUEUE_ENQUEUE(Index)(&c->free_queue, c->render_index);
+    c->render_index = message;
+    c->published += 1;
+  }
+  while (ATOMIC_QUEUE_LENGTH(Index)(&c->dsp_queue) > 0) {
+    const Index sentinel = -1;
+    const Index message = ATOMIC_QUEUE_DEQUEUE(Index)(&c->dsp_queue, sentinel);
+    ASSERT(message != sentinel);
+    ATOMIC_QUEUE_ENQUEUE(Index)(&c->dsp_free_queue, c->render_dsp);
+    c->render_dsp = message;
+  }
+  while (ATOMIC_QUEUE_LENGTH(Index)(&c->profile_queue) > 0) {
+    const Index sentinel = -1;
+    const Index message = ATOMIC_QUEUE_DEQUEUE(Index)(&c->profile_queue, sentinel);
+    ASSERT(message != sentinel);
+    if (c->render_profile != INDEX_NONE) {
+      ATOMIC_QUEUE_ENQUEUE(Index)(&c->profile_free_queue, c->render_profile);
+    }
+    c->render_profile = message;
+  }
+  while (ATOMIC_QUEUE_LENGTH(ControlMessage)(&c->retire_queue) > 0) {
+    ControlMessage sentinel = {0};
+    ControlMessage message = ATOMIC_QUEUE_DEQUEUE(ControlMessage)(&c->retire_queue, sentinel);
+    switch (message.tag) {
+      case CONTROL_MESSAGE_MEMORY_RESIZE:
+        {
+          sim_free_history(&message.resize.primary);
+          sim_free_history(&message.resize.secondary);
+        } break;
+      case CONTROL_MESSAGE_CAPACITY:
+        {
+          if (message.operators > c->primary.program.capacity) {
+            c->primary = sim_allocate_history(SIM_HISTORY, c->primary.dimensions, message.operators);
+            c->secondary = sim_allocate_secondary(c->primary.dimensions);
+            ATOMIC_QUEUE_ENQUEUE(ControlMessage)(&c->control_queue, control_message_memory_resize(c->primary, c->secondary));
+          }
+        } break;
+      default: { }
+    }
+  }
+}
+
+// run the audio simulation for as many beats, with every grid in the rack,
+// taking the render thread's side of each queue between blocks
+static Void run_dsp(const RunnerOptions* options, const Grid* grids, RunnerReport* report)
+{
+  sim_init();
+  for (Index i = 0; i < options->grids; i++) {
+    attach_grid(options, &grids[i], &runner_channels[i]);
+  }
+
+  // settle the tempo before measuring a beat
+  sim_step(runner_audio, 0);
+
+  const Index frames = options->beats * sim_beat_frames(0);
+  for (Index i = 0; i < options->grids; i++) {
+    runner_channels[i].published = 0;
+  }
+  const U64 begin = SDL_GetPerformanceCounter();
+  for (Index elapsed = 0; elapsed < frames; elapsed += RUNNER_BLOCK) {
+    sim_step(runner_audio, MIN(RUNNER_BLOCK, frames - elapsed));
+    for (Index i = 0; i < options->grids; i++) {
+      drain_channel(&runner_channels[i]);
+    }
+    report->dsp_blocks += 1;
+  }
+  report->dsp_seconds = seconds_since(begin);
+  report->dsp_frames = frames;
+  for (Index i = 0; i < options->grids; i++) {
+    report->published += runner_channels[i].published;
+  }
+
+  // The rack is done once it has taken the histories still in the queues,
+  // and then the runner plays the audio thread itself.
+  Bool pending = true;
+  while (pending) {
+    sim_step(runner_audio, 0);
+    pending = false;
+    for (Index i = 0; i < options->grids; i++) {
+      drain_channel(&runner_channels[i]);
+      pending = pending || ATOMIC_QUEUE_LENGTH(ControlMessage)(&runner_channels[i].control_queue) > 0;
+    }
+  }
+  for (Index i = 0; i < options->grids; i++) {
+    sim_free_history(&runner_channels[i].primary);
+    sim_free_history(&runner_channels[i].secondary);
+  }
+}
+
+// print a string as a JSON string literal
+static Void print_json_string(const Char* text)
+{
+  putchar('"');
+  for (const Char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      putchar('\\');
+      putchar(*c);
+    } else if ((U8) *c < 0x20) {
+      printf("\\u%04x", (U8) *c);
+    } else {
+      putchar(*c);
+    }
+  }
+  putchar('"');
+}
+
+static Void print_sweep_json(const RunnerOptions* options, const Grid* grid, const GridReport* r)
+{
+  printf("      \"sweep\": {\n");
+  printf("        \"variants\": %d,\n", MODEL_BATCH);
+  if (r->conflict != INDEX_NONE) {
+    const V2S point = model_point(grid->dimensions, r->conflict);
+    printf("        \"conflict\": [%d, %d]\n", point.x, point.y);
+  } else {
+    const F64 variant_beats = (F64) options->beats * MODEL_BATCH;
+    printf("        \"events\": %td,\n", r->sweep_events);
+    printf("        \"seconds\": %.6f,\n", r->sweep_seconds);
+    printf("        \"variant_beats_per_second\": %.1f,\n", variant_beats / r->sweep_seconds);
+    printf("        \"speedup\": %.2f\n", variant_beats * r->model_seconds / (options->beats * r->sweep_seconds));
+  }
+  printf("      }\n");
+}
+
+static Void print_sweep(const RunnerOptions* options, const Grid* grid, const GridReport* r)
+{
+  if (r->conflict != INDEX_NONE) {
+    const V2S point = model_point(grid->dimensions, r->conflict);
+    printf("sweep refused: operator at %d %d reads or writes other operators\n", point.x, point.y);
+    return;
+  }
+  const F64 variant_beats = (F64) options->beats * MODEL_BATCH;
+  printf("sweep of %d variants: %.3f s, %td events, %.1f variant beats/s (%.2fx)\n",
+      MODEL_BATCH,
+      r->sweep_seconds,
+      r->sweep_events,
+      variant_beats / r->sweep_seconds,
+      variant_beats * r->model_seconds / (options->beats * r->sweep_seconds));
+}
+
+static Void print_report(const RunnerOptions* options, const Grid* grids, const RunnerReport* report)
+{
+  const F64 frames_per_second = options->dsp ? report->dsp_frames / report->dsp_seconds : 0.0;
+  const F64 realtime = frames_per_second / Config_AUDIO_SAMPLE_RATE;
+  const Char* const engine = options->reference ? "reference" : "compiled";
+
+  if (options->json) {
+    printf("{\n");
+    printf("  \"engine\": \"%s\",\n", engine);
+    printf("  \"beats\": %td,\n", options->beats);
+    printf("  \"grids\": [\n");
+  }
+
+  for (Index i = 0; i < options->grids; i++) {
+    const Grid* const grid = &grids[i];
+    const GridReport* const r = &report->grids[i];
+    const Index area = grid->dimensions.x * grid->dimensions.y;
+    const F64 beats_per_second = (F64) options->beats / r->model_seconds;
+    const F64 ns_per_cell = r->model_seconds * GIGA / ((F64) options->beats * (F64) area);
+    if (options->json) {
+      printf("    {\n");
+      printf("      \"path\": ");
+      print_json_string(options->paths[i]);
+      printf(",\n");
+      printf("      \"dimensions\": [%d, %d],\n", grid->dimensions.x, grid->dimensions.y);
+      printf("      \"events\": %td,\n", r->events);
+      printf("      \"events_dropped\": %td,\n", r->dropped);
+      printf("      \"model_seconds\": %.6f,\n", r->model_seconds);
+      printf("      \"beats_per_second\": %.1f,\n", beats_per_second);
+      printf("      \"ns_per_cell\": %.3f%s\n", ns_per_cell, options->sweep ? "," : "");
+      if (options->sweep) {
+        print_sweep_json(options, grid, r);
+      }
+      printf("    }%s\n", i + 1 < options->grids ? "," : "");
+    } else {
+      printf("%s: %dx%d, %s engine\n", options->paths[i], grid->dimensions.x, grid->dimensions.y, engine);
+      printf("%td beats in %.3f s, %td events (%td dropped)\n",
+          options->beats, r->model_seconds, r->events, r->dropped);
+      printf("%.1f beats/s, %.3f ns/cell\n", beats_per_second, ns_per_cell);
+      if (options->sweep) {
+        print_sweep(options, grid, r);
+      }
+    }
+  }
+
+  if (options->json) {
+    printf("  ]%s\n", options->dsp ? "," : "");
+    if (options->dsp) {
+      printf("  \"instances\": %td,\n", options->grids);
+      printf("  \"dsp_seconds\": %.6f,\n", report->dsp_seconds);
+      printf("  \"audio_frames\": %td,\n", report->dsp_frames);
+      printf("  \"audio_blocks\": %td,\n", report->dsp_blocks);
+      printf("  \"slots_published\": %td,\n", report->published);
+      printf("  \"audio_frames_per_second\": %.1f,\n", frames_per_second);
+      printf("  \"realtime_factor\": %.2f\n", realtime);
+    }
+    printf("}\n");
+  } else if (options->dsp) {
+    printf("rack of %td: %td audio frames in %.3f s\n", options->grids, report->dsp_frames, report->dsp_seconds);
+    printf("%td slots published over %td blocks\n", report->published, report->dsp_blocks);
+    printf("%.1f audio frames/s, %.2fx realtime\n", frames_per_second, realtime);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  RunnerOptions options = {0};
+  if (parse_options(argc, argv, &options) == false) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  Grid grids[SIM_INSTANCES] = {0};
+  for (Index i = 0; i < options.grids; i++) {
+    if (load_grid(options.paths[i], &grids[i]) == false) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  RunnerReport report = {0};
+  for (Index i = 0; i < options.grids; i++) {
+    run_model(&options, &grids[i], &report.grids[i]);
+    if (options.sweep) {
+      run_sweep(&options, &grids[i], &report.grids[i]);
+    }
+  }
+  if (options.dsp) {
+    run_dsp(&options, grids, &report);
+  }
+  print_report(&options, grids, &report);
+
+  for (Index i = 0; i < options.grids; i++) {
+    free(grids[i].rows);
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,12 +1,15 @@
-#define SK_ENV_PRIV
 #include <math.h>
+#include <string.h>
+#include <SDL3/SDL_stdinc.h>
 #include <SDL3/SDL_log.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_timer.h>
 #include "sim.h"
 #include "config.h"
 #include "palette.h"
 #include "comms.h"
 #include "bigverb.h"
-#include "env.h"
 
 #define VOICE_DURATION 12000
 #define REFERENCE_TONE 440
@@ -19,18 +22,75 @@
 #define REVERB_DEFAULT_SIZE 0.93f
 #define REVERB_DEFAULT_CUTOFF 10000.f
 
+// limits on a replayable cycle
+#define SIM_CYCLE_BEATS 0x100
+#define SIM_CYCLE_WRITES 0x4000
+#define SIM_CYCLE_TRIGGERS 0x1000
+
+// the most events evaluated in one beat
+#define SIM_EVENTS 0x1000
+
+// Band-limited wavetables, with one level per octave of the fundamental.
+// Level l keeps the harmonics up to SIM_WAVETABLE >> (l + 2), so its last
+// level is a pure sine. A 32-bit phase indexes a table with its top bits,
+// and interpolates with the rest.
+#define SIM_WAVETABLE_BITS 11
+#define SIM_WAVETABLE (1 << SIM_WAVETABLE_BITS)
+#define SIM_WAVETABLE_LEVELS (SIM_WAVETABLE_BITS - 1)
+#define SIM_PHASE_FRACTION_BITS (32 - SIM_WAVETABLE_BITS)
+
+// The attack and the release are one-pole curves toward one and zero, and
+// each ends on the frame its level comes within SIM_ENVELOPE_EPSILON, about
+// -146 dB, of its target. Envelopes render in runs of SIM_ENVELOPE_LANES
+// independent frames.
+#define SIM_ENVELOPE_EPSILON 5e-8
+#define SIM_ENVELOPE_LANES 8
+
 // midi is not implemented yet
 #define platform_midi_init(...)
 #define platform_midi_note_on(...)
 #define platform_midi_note_off(...)
 
+// The attack and release are one-pole curves toward 1 and 0, and the hold
+// keeps the level the attack reached. The length of every stage is known
+// when the voice starts, so a block renders each stage it covers as a whole
+// segment.
+typedef enum EnvelopeStage {
+  ENVELOPE_OFF,
+  ENVELOPE_ATTACK,
+  ENVELOPE_HOLD,
+  ENVELOPE_RELEASE,
+} EnvelopeStage;
+
+typedef struct Envelope {
+  EnvelopeStage stage;
+  Index remaining;                        // frames left in the stage
+  Index hold;                             // frames in the later stages
+  Index release;
+  F32 level;                              // the last gain rendered
+  F32 attack_pole;                        // per-frame coefficients
+  F32 release_pole;
+} Envelope;
+
+typedef enum Waveform {
+  WAVEFORM_SINE,
+  WAVEFORM_TRIANGLE,
+  WAVEFORM_SAW,
+  WAVEFORM_SQUARE,
+  WAVEFORM_CARDINAL,
+} Waveform;
+
 typedef struct SynthVoice {
 
   // envelope state
-  sk_env envelope;
+  Envelope envelope;
 
-  // elapsed frames
-  Index frame;
+  // oscillator state, in cycles scaled to 2^32
+  U32 phase;
+  U32 increment;
+
+  // the wavetable level for its pitch
+  const F32* table;
 
   // pitch in semitones
   S32 pitch;
@@ -43,40 +103,128 @@ typedef struct SynthVoice {
 typedef struct SamplerVoice {
 
   // envelope state
-  sk_env envelope;
+  Envelope envelope;
 
-  // elapsed frames
-  Index frame;
+  // playhead in frames, kept within the sound
+  F64 head;
+
+  // frames advanced per output frame
+  F64 rate;
 
   // sound index
   S32 sound;
 
-  // start time
-  S32 start;
-
-  // relative pitch
-  S32 pitch;
-
   // fractional volume
   F32 volume;
 
 } SamplerVoice;
 
+typedef enum CycleTag {
+  CYCLE_SEARCH,                           // looking for a repeated state
+  CYCLE_RECORD,                           // evaluating one period, recording it
+  CYCLE_REPLAY,                           // replaying the recorded period
+} CycleTag;
+
+typedef struct CycleWrite {
+  S32 offset;
+  Cell cell;
+} CycleWrite;
+
+// Once memory and registers repeat, evaluation is periodic. The search
+// compares each beat against a snapshot, doubling the window when it runs out
+// (Brent's method). A match is then evaluated for one more period, recording
+// the memory writes, registers and triggers of each beat, and replayed only
+// if that period also closes. Frame-dependent operators must agree with the
+// period as well, which the frame period reported by the model guarantees.
+typedef struct Cycle {
+  CycleTag tag;
+  Index power;                            // search window, zero to restart
+  Index length;                           // beats since the snapshot
+  Index frame_period;                     // of the beats since the snapshot
+  RegisterFile registers;                 // registers at the snapshot
+  Index period;                           // beats in the cycle
+  Index beat;                             // position within the cycle
+  Index write_heads[SIM_CYCLE_BEATS + 1];
+  Index trigger_heads[SIM_CYCLE_BEATS + 1];
+  RegisterFile register_files[SIM_CYCLE_BEATS];
+  CycleWrite writes[SIM_CYCLE_WRITES];
+  ModelEvent triggers[SIM_CYCLE_TRIGGERS];
+} Cycle;
+
+// One program in the rack. The audio thread owns everything here, and the
+// render thread reaches it only through the channel.
+typedef struct SimInstance {
+
+  // queues to and from the render thread
+  SimChannel channel;
+
+  // history pointers
+  ProgramHistory history;
+  ProgramHistory backup;
+
+  // operators the render thread has been asked to make room for
+  Index requested;
+
+  // index into model history
+  Index head;
+
+  // frames elapsed since startup
+  Index frame;
+
+  // playback parameters
+  S32 tempo;
+  Bool pause;
+
+  // Voice data. The indices are a stack of free voices. The sounding voices
+  // are kept dense in `active`, and `places` locates each one there, so a
+  // voice retires by swapping the last into its place.
+  SynthVoice synth_voices[SIM_VOICES];
+  Index synth_voice_indices[SIM_VOICES];
+  Index synth_voice_head;
+  Index synth_voice_active[SIM_VOICES];
+  Index synth_voice_places[SIM_VOICES];
+  Index synth_voice_active_count;
+
+  SamplerVoice sampler_voices[SIM_VOICES];
+  Index sampler_voice_indices[SIM_VOICES];
+  Index sampler_voice_head;
+  Index sampler_voice_active[SIM_VOICES];
+  Index sampler_voice_places[SIM_VOICES];
+  Index sampler_voice_active_count;
+
+  // periodicity state
+  Cycle cycle;
+
+  // profile window being accumulated, and the beats it covers so far
+  Index profile_head;
+  Index profile_beats;
+
+  // events of the current beat
+  ModelEvent event_buffer[SIM_EVENTS];
+  EventSink events;
+
+  // the slot being written this period, and its dsp state
+  Bool publish;                           // false if nothing can change
+  Index next_head;
+  ProgramHistory next;
+  Index dsp_head;
+  DSPState* dsp_state;
+  DSPState backup_dsp;
+
+  // output for the current block, before mixing
+  F32 audio[STEREO * SIM_BLOCK];
+
+} SimInstance;
+
 // history buffers
 DSPState dsp_history[SIM_HISTORY] = {0};
 
 // palette
 static Sound sim_palette[MODEL_RADIX] = {0};
 
-// history pointers
-static ProgramHistory sim_history = {0};
-static ProgramHistory sim_backup = {0};
-
-// index into model history
-static Index sim_head = 0;
-
-// frames elapsed since startup
-static Index sim_frame = 0;
+// programs in the rack
+static SimInstance sim_instances[SIM_INSTANCES] = {0};
+static Index sim_instance_count = 0;
 
 // global dsp parameters
 static F32 sim_global_volume = 1.f;
@@ -84,50 +232,109 @@ static Bool sim_reverb_status = true;
 static F32 sim_reverb_mix = 0.12f;
 static F32 sim_envelope_coefficient = 0.0001f;
 static F32 sim_envelope_exponent = 0.3f;
-static S32 sim_tempo = 80;
-static Bool sim_pause = false;
-
-// synth voice data
-static SynthVoice sim_synth_voices[SIM_VOICES] = {0};
-static Index sim_synth_voice_indices[SIM_VOICES] = {0};
-static Index sim_synth_voice_head = 0;
-
-// sampler voice data
-static SamplerVoice sim_sampler_voices[SIM_VOICES] = {0};
-static Index sim_sampler_voice_indices[SIM_VOICES] = {0};
-static Index sim_sampler_voice_head = 0;
 
 // sndkit data
 static sk_bigverb* sim_bigverb = NULL;
 
+// oscillator tables, built once by sim_init, with a guard sample for interpolation
+static F32 sim_wavetables[WAVEFORM_CARDINAL][SIM_WAVETABLE_LEVELS][SIM_WAVETABLE + 1] = {0};
+
+// envelope poles and hold lengths for each parameter value, built by sim_init
+static F32 sim_envelope_poles[MODEL_RADIX] = {0};
+static Index sim_envelope_holds[MODEL_RADIX] = {0};
+
+// Worker threads for lanes of evaluation. Each worker waits on its own
+// semaphore for a task, and the audio thread runs the first lane itself.
+typedef struct WorkerPool {
+  SDL_Thread* threads[MODEL_LANES];
+  SDL_Semaphore* start[MODEL_LANES];
+  SDL_Semaphore* done;
+  Void (*task)(Void* arg, Index lane);
+  Void* arg;
+} WorkerPool;
+
+static WorkerPool sim_workers = {0};
+static ModelPool sim_pool = {0};
+
 _Static_assert(
     MESSAGE_QUEUE_CAPACITY >= SIM_HISTORY,
     "message queue capacity must be greater than simulation history"
     );
 
+_Static_assert(
+    MESSAGE_QUEUE_CAPACITY >= SIM_PROFILES,
+    "message queue capacity must be greater than the profile windows"
+    );
+
 _Static_assert(
     MODEL_RADIX == PALETTE_SOUNDS,
     "invalid palette size"
     );
 
-static ProgramHistory lookup_history_index(Index index)
+static ProgramHistory lookup_history_index(const SimInstance* s, Index index)
 {
-  const Index area = sim_history.dimensions.x * sim_history.dimensions.y;
+  const Index cells = MODEL_CELLS(s->history.dimensions);
   ProgramHistory program;
-  program.dimensions = sim_history.dimensions;
+  program.dimensions = s->history.dimensions;
   if (index >= 0) {
     // @rdk: Pull this logic out, to be shared with clavier module.
-    program.register_file   = &sim_history.register_file[index];
-    program.memory          = &sim_history.memory[index * area];
-    program.graph           = &sim_history.graph[index * GRAPH_FACTOR * area];
+    program.register_file   = &s->history.register_file[index];
+    program.memory          = &s->history.memory[index * cells];
   } else {
-    program.register_file   = sim_backup.register_file;
-    program.memory          = sim_backup.memory;
-    program.graph           = sim_backup.graph;
+    program.register_file   = s->backup.register_file;
+    program.memory          = s->backup.memory;
   }
   return program;
 }
 
+static int SDLCALL worker_main(Void* data)
+{
+  const Index lane = (Index) (intptr_t) data;
+  while (true) {
+    SDL_WaitSemaphore(sim_workers.start[lane]);
+    sim_workers.task(sim_workers.arg, lane);
+    SDL_SignalSemaphore(sim_workers.done);
+  }
+  return 0;
+}
+
+static Void worker_run(Void* context, Void (*task)(Void* arg, Index lane), Void* arg, Index count)
+{
+  WorkerPool* const pool = context;
+  ASSERT(count <= MODEL_LANES);
+  pool->task = task;
+  pool->arg = arg;
+  for (Index lane = 1; lane < count; lane++) {
+    SDL_SignalSemaphore(pool->start[lane]);
+  }
+  task(arg, 0);
+  for (Index lane = 1; lane < count; lane++) {
+    SDL_WaitSemaphore(pool->done);
+  }
+}
+
+// start the workers, returning false if the platform cannot
+static Bool worker_init(Void)
+{
+#ifdef __EMSCRIPTEN__
+  return false;
+#else
+  sim_workers.done = SDL_CreateSemaphore(0);
+  if (sim_workers.done == NULL) {
+    return false;
+  }
+  for (Index lane = 1; lane < MODEL_LANES; lane++) {
+    sim_workers.start[lane] = SDL_CreateSemaphore(0);
+    sim_workers.threads[lane] = SDL_CreateThread(worker_main, "sim worker", (Void*) (intptr_t) lane);
+    if (sim_workers.start[lane] == NULL || sim_workers.threads[lane] == NULL) {
+      SDL_Log("failed to start worker: %s", SDL_GetError());
+      return false;
+    }
+  }
+  return true;
+#endif
+}
+
 static Index bpm_to_period(S32 tempo)
 {
   return (Config_AUDIO_SAMPLE_RATE * 60) / (tempo * 8);
@@ -139,356 +346,829 @@ static F32 to_hz(F32 pitch)
   return REFERENCE_TONE * powf(SIM_TWELFTH_ROOT_TWO, power);
 }
 
-static Index pop_synth_voice()
+// the amplitude of a harmonic in the fourier series of a waveform
+static F32 waveform_harmonic(Waveform waveform, Index k)
+{
+  const F32 odd = k % 2 == 1 ? 1.f : 0.f;
+  switch (waveform) {
+    case WAVEFORM_SINE:
+      return k == 1 ? 1.f : 0.f;
+    case WAVEFORM_TRIANGLE:
+      return odd * ((k / 2) % 2 ? -8.f : 8.f) / (SIM_PI * SIM_PI * k * k);
+    case WAVEFORM_SAW:
+      return (k % 2 ? 2.f : -2.f) / (SIM_PI * k);
+    case WAVEFORM_SQUARE:
+      return odd * 4.f / (SIM_PI * k);
+    default:
+      return 0.f;
+  }
+}
+
+// sum each table from its harmonics, reading one sine cycle at a stride
+static Void build_wavetables(Void)
+{
+  static F32 sine[SIM_WAVETABLE];
+  for (Index n = 0; n < SIM_WAVETABLE; n++) {
+    sine[n] = sinf(2.f * SIM_PI * n / SIM_WAVETABLE);
+  }
+
+  for (Index w = 0; w < WAVEFORM_CARDINAL; w++) {
+    for (Index l = 0; l < SIM_WAVETABLE_LEVELS; l++) {
+      F32* const table = sim_wavetables[w][l];
+      const Index harmonics = SIM_WAVETABLE >> (l + 2);
+      for (Index k = 1; k <= harmonics; k++) {
+        const F32 amplitude = waveform_harmonic((Waveform) w, k);
+        if (amplitude != 0.f) {
+          for (Index n = 0; n < SIM_WAVETABLE; n++) {
+            table[n] += amplitude * sine[(k * n) & (SIM_WAVETABLE - 1)];
+          }
+        }
+      }
+      table[SIM_WAVETABLE] = table[0];
+    }
+  }
+}
+
+// the richest level whose harmonics all stay below nyquist
+static const F32* wavetable_level(Waveform waveform, F32 hz)
+{
+  const F32 limit = Config_AUDIO_SAMPLE_RATE / (2.f * hz);
+  Index l = 0;
+  while (l < SIM_WAVETABLE_LEVELS - 1 && (SIM_WAVETABLE >> (l + 2)) > limit) {
+    l += 1;
+  }
+  return sim_wavetables[waveform][l];
+}
+
+// add an oscillator to a mono block, starting at `phase`
+static Void oscillate(const F32* table, U32 phase, U32 increment, const F32* gain, F32* out, Index frames)
+{
+  const U32 mask = (1u << SIM_PHASE_FRACTION_BITS) - 1;
+  const F32 scale = 1.f / (F32) (1u << SIM_PHASE_FRACTION_BITS);
+  Index i = 0;
+#if SIMD
+  U32x4 p = u32x4_set(phase, phase + increment, phase + 2 * increment, phase + 3 * increment);
+  const U32x4 step = u32x4_splat(SIMD_LANES * increment);
+  for (; i + SIMD_LANES <= frames; i += SIMD_LANES) {
+    U32 index[SIMD_LANES];
+    u32x4_store(index, u32x4_shr(p, SIM_PHASE_FRACTION_BITS));
+    const F32x4 fraction = f32x4_mul(f32x4_of_u32x4(u32x4_and(p, u32x4_splat(mask))), f32x4_splat(scale));
+    const F32x4 a = f32x4_set(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+    const F32x4 b = f32x4_set(table[index[0] + 1], table[index[1] + 1], table[index[2] + 1], table[index[3] + 1]);
+    const F32x4 sample = f32x4_add(a, f32x4_mul(fraction, f32x4_sub(b, a)));
+    f32x4_store(&out[i], f32x4_add(f32x4_load(&out[i]), f32x4_mul(sample, f32x4_load(&gain[i]))));
+    p = u32x4_add(p, step);
+  }
+#endif
+  for (; i < frames; i++) {
+    const U32 p = phase + (U32) i * increment;
+    const U32 index = p >> SIM_PHASE_FRACTION_BITS;
+    const F32 fraction = (F32) (p & mask) * scale;
+    const F32 sample = table[index] + fraction * (table[index + 1] - table[index]);
+    out[i] += sample * gain[i];
+  }
+}
+
+// the curved duration of an envelope parameter, in seconds
+static F32 envelope_seconds(S32 parameter)
+{
+  return sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * parameter);
+}
+
+static Void build_envelope_tables(Void)
+{
+  for (S32 i = 0; i < MODEL_RADIX; i++) {
+    const F64 frames = (F64) envelope_seconds(i) * Config_AUDIO_SAMPLE_RATE;
+    sim_envelope_poles[i] = (F32) exp(-1.0 / frames);
+    sim_envelope_holds[i] = MAX(1, (Index) ceil(frames));
+  }
+}
+
+// frames of a one-pole decay by `pole` before `distance` is within `epsilon`
+static Index envelope_decay_frames(F64 distance, F64 pole, F64 epsilon)
 {
-  if (sim_synth_voice_head > 0) {
-    sim_synth_voice_head -= 1;
-    const Index index = sim_synth_voice_indices[sim_synth_voice_head];
-    sim_synth_voice_indices[sim_synth_voice_head] = INDEX_NONE;
+  return distance > epsilon ? (Index) ceil(log(epsilon / distance) / log(pole)) : 0;
+}
+
+// Start an envelope from silence. The attack and release end on the frame
+// they come within SIM_ENVELOPE_EPSILON, and the trigger itself takes the
+// first frame of the attack.
+static Void envelope_start(Envelope* e, S32 attack, S32 hold, S32 release)
+{
+  ASSERT(attack >= 0 && attack < MODEL_RADIX);
+  ASSERT(hold >= 0 && hold < MODEL_RADIX);
+  ASSERT(release >= 0 && release < MODEL_RADIX);
+  const F64 a = sim_envelope_poles[attack];
+  const F64 r = sim_envelope_poles[release];
+  const Index attack_frames = 1 + envelope_decay_frames(1.0 - a, a, SIM_ENVELOPE_EPSILON);
+  const F64 peak = 1.0 - pow(a, (F64) attack_frames);
+
+  e->attack_pole = (F32) a;
+  e->release_pole = (F32) r;
+  e->hold = sim_envelope_holds[hold];
+  e->release = MAX(1, envelope_decay_frames(peak, r, SIM_ENVELOPE_EPSILON));
+  e->level = (F32) (1.0 - a);
+  e->remaining = attack_frames - 1;
+  e->stage = ENVELOPE_ATTACK;
+  if (e->remaining == 0) {
+    e->stage = ENVELOPE_HOLD;
+    e->remaining = e->hold;
+  }
+}
+
+// Write `scale * (target + (level - target) * pole^(i + 1))` for a segment,
+// and return its last unscaled value. Each of SIM_ENVELOPE_LANES frames steps
+// by pole^SIM_ENVELOPE_LANES from its own offset.
+static F32 envelope_ramp(F32* out, Index frames, F32 level, F32 target, F32 pole, F32 scale)
+{
+  F32 offsets[SIM_ENVELOPE_LANES];
+  F32 offset = level - target;
+  F32 stride = 1.f;
+  for (Index k = 0; k < SIM_ENVELOPE_LANES; k++) {
+    offset *= pole;
+    offsets[k] = offset;
+    stride *= pole;
+  }
+
+  F32 last = level;
+  Index i = 0;
+#if SIMD
+  ASSERT(SIM_ENVELOPE_LANES == 2 * SIMD_LANES);
+  const F32x4 targets = f32x4_splat(target);
+  const F32x4 scales = f32x4_splat(scale);
+  const F32x4 strides = f32x4_splat(stride);
+  F32x4 lo = f32x4_load(&offsets[0]);
+  F32x4 hi = f32x4_load(&offsets[SIMD_LANES]);
+  F32x4 previous = hi;
+  for (; i + SIM_ENVELOPE_LANES <= frames; i += SIM_ENVELOPE_LANES) {
+    f32x4_store(&out[i], f32x4_mul(scales, f32x4_add(targets, lo)));
+    f32x4_store(&out[i + SIMD_LANES], f32x4_mul(scales, f32x4_add(targets, hi)));
+    previous = hi;
+    lo = f32x4_mul(lo, strides);
+    hi = f32x4_mul(hi, strides);
+  }
+  if (i > 0) {
+    f32x4_store(&offsets[SIMD_LANES], previous);
+    last = target + offsets[SIM_ENVELOPE_LANES - 1];
+  }
+  f32x4_store(&offsets[0], lo);
+  f32x4_store(&offsets[SIMD_LANES], hi);
+#endif
+  for (; i + SIM_ENVELOPE_LANES <= frames; i += SIM_ENVELOPE_LANES) {
+    for (Index k = 0; k < SIM_ENVELOPE_LANES; k++) {
+      out[i + k] = scale * (target + offsets[k]);
+    }
+    last = target + offsets[SIM_ENVELOPE_LANES - 1];
+    for (Index k = 0; k < SIM_ENVELOPE_LANES; k++) {
+      offsets[k] *= stride;
+    }
+  }
+  for (Index k = 0; i < frames; i++, k++) {
+    out[i] = scale * (target + offsets[k]);
+    last = target + offsets[k];
+  }
+  return last;
+}
+
+// render an envelope's gain for a block, scaled by a voice's volume
+static Void envelope_render(Envelope* e, F32 scale, F32* gain, Index frames)
+{
+  Index i = 0;
+  while (i < frames) {
+    if (e->stage == ENVELOPE_OFF) {
+      memset(&gain[i], 0, (frames - i) * sizeof(F32));
+      break;
+    }
+
+    const Index n = MIN(e->remaining, frames - i);
+    switch (e->stage) {
+      case ENVELOPE_ATTACK:
+        e->level = envelope_ramp(&gain[i], n, e->level, 1.f, e->attack_pole, scale);
+        break;
+      case ENVELOPE_HOLD:
+        for (Index j = 0; j < n; j++) {
+          gain[i + j] = scale * e->level;
+        }
+        break;
+      case ENVELOPE_RELEASE:
+        e->level = envelope_ramp(&gain[i], n, e->level, 0.f, e->release_pole, scale);
+        break;
+      default:
+        break;
+    }
+    i += n;
+    e->remaining -= n;
+
+    // move to the next stage on the frame this one ends
+    if (e->remaining == 0) {
+      switch (e->stage) {
+        case ENVELOPE_ATTACK:
+          e->stage = ENVELOPE_HOLD;
+          e->remaining = e->hold;
+          break;
+        case ENVELOPE_HOLD:
+          e->stage = ENVELOPE_RELEASE;
+          e->remaining = e->release;
+          break;
+        default:
+          e->stage = ENVELOPE_OFF;
+          e->level = 0.f;
+          break;
+      }
+    }
+  }
+}
+
+static Index pop_synth_voice(SimInstance* s)
+{
+  if (s->synth_voice_head > 0) {
+    s->synth_voice_head -= 1;
+    const Index index = s->synth_voice_indices[s->synth_voice_head];
+    s->synth_voice_indices[s->synth_voice_head] = INDEX_NONE;
+    s->synth_voice_places[index] = s->synth_voice_active_count;
+    s->synth_voice_active[s->synth_voice_active_count] = index;
+    s->synth_voice_active_count += 1;
     return index;
   } else {
     return INDEX_NONE;
   }
 }
 
-static Void push_synth_voice(Index index)
+static Void push_synth_voice(SimInstance* s, Index index)
 {
-  if (sim_synth_voice_head < SIM_VOICES) {
-    sim_synth_voice_indices[sim_synth_voice_head] = index;
-    sim_synth_voice_head += 1;
+  if (s->synth_voice_head < SIM_VOICES) {
+    s->synth_voice_indices[s->synth_voice_head] = index;
+    s->synth_voice_head += 1;
   }
 }
 
-static Void clear_synth_voice(Index index)
+static Void clear_synth_voice(SimInstance* s, Index index)
 {
   if (index >= 0) {
-    sim_synth_voices[index] = (SynthVoice) {0};
-    push_synth_voice(index);
+    const Index place = s->synth_voice_places[index];
+    if (place < s->synth_voice_active_count && s->synth_voice_active[place] == index) {
+      s->synth_voice_active_count -= 1;
+      const Index last = s->synth_voice_active[s->synth_voice_active_count];
+      s->synth_voice_active[place] = last;
+      s->synth_voice_places[last] = place;
+    }
+    s->synth_voices[index] = (SynthVoice) {0};
+    push_synth_voice(s, index);
   }
 }
 
-static Index pop_sampler_voice()
+static Index pop_sampler_voice(SimInstance* s)
 {
-  if (sim_sampler_voice_head > 0) {
-    sim_sampler_voice_head -= 1;
-    const Index index = sim_sampler_voice_indices[sim_sampler_voice_head];
-    sim_sampler_voice_indices[sim_sampler_voice_head] = INDEX_NONE;
+  if (s->sampler_voice_head > 0) {
+    s->sampler_voice_head -= 1;
+    const Index index = s->sampler_voice_indices[s->sampler_voice_head];
+    s->sampler_voice_indices[s->sampler_voice_head] = INDEX_NONE;
+    s->sampler_voice_places[index] = s->sampler_voice_active_count;
+    s->sampler_voice_active[s->sampler_voice_active_count] = index;
+    s->sampler_voice_active_count += 1;
     return index;
   } else {
     return INDEX_NONE;
   }
 }
 
-static Void push_sampler_voice(Index index)
+static Void push_sampler_voice(SimInstance* s, Index index)
 {
-  if (sim_sampler_voice_head < SIM_VOICES) {
-    sim_sampler_voice_indices[sim_sampler_voice_head] = index;
-    sim_sampler_voice_head += 1;
+  if (s->sampler_voice_head < SIM_VOICES) {
+    s->sampler_voice_indices[s->sampler_voice_head] = index;
+    s->sampler_voice_head += 1;
   }
 }
 
-static Void clear_sampler_voice(Index index)
+static Void clear_sampler_voice(SimInstance* s, Index index)
 {
   if (index >= 0) {
-    sim_sampler_voices[index] = (SamplerVoice) {0};
-    sim_sampler_voices[index].sound = INDEX_NONE;
-    push_sampler_voice(index);
+    const Index place = s->sampler_voice_places[index];
+    if (place < s->sampler_voice_active_count && s->sampler_voice_active[place] == index) {
+      s->sampler_voice_active_count -= 1;
+      const Index last = s->sampler_voice_active[s->sampler_voice_active_count];
+      s->sampler_voice_active[place] = last;
+      s->sampler_voice_places[last] = place;
+    }
+    s->sampler_voices[index] = (SamplerVoice) {0};
+    s->sampler_voices[index].sound = INDEX_NONE;
+    push_sampler_voice(s, index);
   }
 }
 
-static Void sim_step_model(Model* m, GraphEdge* graph)
+// read the operand a number of tiles west of an event
+static S32 event_literal(const ModelEvent* event, S32 distance, S32 none)
 {
-  // const Index area = sim_history.dimensions.x * sim_history.dimensions.y;
-  model_step(m, graph);
+  return read_literal(value_of_cell(event->operands[distance - 1]), none);
+}
 
-  // shorthand
-  const V2S west = unit_vector(DIRECTION_WEST);
+// start the voice or message for an event
+static Void sim_trigger(SimInstance* s, const ModelEvent* event)
+{
+  // process synth event, where only the wavetable synth reads a waveform
+  if (event->tag == VALUE_SYNTH || event->tag == VALUE_WAVE) {
+
+    const Index voice_index = pop_synth_voice(s);
+    if (voice_index != INDEX_NONE) {
+
+      // parameter values
+      const S32 waveform  = event->tag == VALUE_WAVE ? event_literal(event, 7, 0) : WAVEFORM_SINE;
+      const S32 octave    = event_literal(event, 6, 0);
+      const S32 pitch     = event_literal(event, 5, 0);
+      const S32 velocity  = event_literal(event, 4, 0);
+      const S32 attack    = event_literal(event, 3, 0);
+      const S32 hold      = event_literal(event, 2, 0);
+      const S32 release   = event_literal(event, 1, 0);
+
+      // voice to initialize
+      SynthVoice* const voice = &s->synth_voices[voice_index];
+      envelope_start(&voice->envelope, attack, hold, release);
+
+      // initialize parameters
+      voice->pitch = OCTAVE * octave + pitch;
+      voice->volume = (F32) velocity / MODEL_RADIX;
+
+      // The synth has always played at half of to_hz, and keeps that pitch.
+      // Past nyquist the increment would wrap, so it stops there.
+      const F32 hz = MIN(to_hz((F32) voice->pitch) / 2.f, Config_AUDIO_SAMPLE_RATE / 2.f);
+      voice->phase = 0;
+      voice->increment = (U32) ((F64) hz / Config_AUDIO_SAMPLE_RATE * 4294967296.0);
+      voice->table = wavetable_level(waveform < WAVEFORM_CARDINAL ? (Waveform) waveform : WAVEFORM_SINE, hz);
 
-  // process synth events
-  for (Index y = 0; y < sim_history.dimensions.y; y++) {
-    for (Index x = 0; x < sim_history.dimensions.x; x++) {
+    }
+  }
 
-      const V2S origin = { (S32) x, (S32) y };
-      const Value value = MODEL_INDEX(m, x, y);
+  // process sampler event
+  if (event->tag == VALUE_SAMPLER) {
 
-      // check for adjacent bang
-      Bool bang = false;
-      for (Direction d = 0; d < DIRECTION_CARDINAL; d++) {
-        const V2S c = add_unit_vector(origin, d);
-        const Value adj = model_get(m, c);
-        if (adj.tag == VALUE_BANG) {
-          bang = true;
-        }
-      }
+    // parameter positions
+    const S32 sound_index = event_literal(event, 7, INDEX_NONE);
+    const S32 offset      = event_literal(event, 6, 0);
+    const S32 velocity    = event_literal(event, 5, 0);
+    const S32 attack      = event_literal(event, 4, 0);
+    const S32 hold        = event_literal(event, 3, 0);
+    const S32 release     = event_literal(event, 2, 0);
+    const S32 pitch       = event_literal(event, 1, MODEL_RADIX / 2);
 
-      // process synth event
-      if (value.tag == VALUE_SYNTH && bang) {
-
-        const Index voice_index = pop_synth_voice();
-        if (voice_index != INDEX_NONE) {
-
-          // parameter values
-          const S32 octave    = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 6))), 0);
-          const S32 pitch     = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 5))), 0);
-          const S32 velocity  = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 4))), 0);
-          const S32 attack    = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 3))), 0);
-          const S32 hold      = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 2))), 0);
-          const S32 release   = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 1))), 0);
-
-          // curved values
-          const F32 curved_attack =
-            sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * attack);
-          const F32 curved_hold =
-            sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * hold);
-          const F32 curved_release =
-            sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * release);
-
-          // voice to initialize
-          SynthVoice* const voice = &sim_synth_voices[voice_index];
-
-          // initialize envelope
-          sk_env_init(&voice->envelope, Config_AUDIO_SAMPLE_RATE);
-          sk_env_attack(&voice->envelope, curved_attack);
-          sk_env_hold(&voice->envelope, curved_hold);
-          sk_env_release(&voice->envelope, curved_release);
-          sk_env_tick(&voice->envelope, 1.f);
-
-          // initialize parameters
-          voice->frame = 0;
-          voice->pitch = OCTAVE * octave + pitch;
-          voice->volume = (F32) velocity / MODEL_RADIX;
+    // A voice is only taken for a sound that can play, so every active voice
+    // is sounding.
+    const Sound* const sound = sound_index != INDEX_NONE ? &sim_palette[sound_index] : NULL;
+    const Index voice_index = sound && sound->samples ? pop_sampler_voice(s) : INDEX_NONE;
+    if (voice_index != INDEX_NONE) {
 
-        }
-      }
+      ASSERT(sound->frames > 0);
+
+      // voice to initialize
+      SamplerVoice* const voice = &s->sampler_voices[voice_index];
+
+      // initialize envelope
+      envelope_start(&voice->envelope, attack, hold, release);
+
+      // initialize parameters
+      voice->head = (F64) ((offset * sound->frames) / MODEL_RADIX);
+      voice->rate = powf(SIM_TWELFTH_ROOT_TWO, (F32) (pitch - MODEL_RADIX / 2));
+      voice->sound = sound_index;
+      voice->volume = (F32) velocity / MODEL_RADIX;
+
+    }
+  }
 
-      // process sampler event
-      if (value.tag == VALUE_SAMPLER && bang) {
+  // process midi event
+  if (event->tag == VALUE_MIDI) {
 
-        const Index voice_index = pop_sampler_voice();
+    // parameter values
+    const S32 octave    = event_literal(event, 5, 0);
+    const S32 pitch     = event_literal(event, 4, 0);
+    const S32 velocity  = event_literal(event, 3, 0);
+    const S32 channel   = event_literal(event, 2, 0);
+    const S32 device    = event_literal(event, 1, 0);
 
-        // parameter positions
-        const S32 sound_index = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 7))), INDEX_NONE);
-        const S32 offset      = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 6))), 0);
-        const S32 velocity    = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 5))), 0);
-        const S32 attack      = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 4))), 0);
-        const S32 hold        = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 3))), 0);
-        const S32 release     = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 2))), 0);
-        const S32 pitch       = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 1))), MODEL_RADIX / 2);
+    // curved values
+    const U32 semitones = OCTAVE * (U32) octave + (U32) pitch;
+    const U32 curved_velocity = 3 * (U32) velocity;
 
-        if (voice_index != INDEX_NONE && sound_index != INDEX_NONE) {
+    // send midi message
+    platform_midi_note_on(device, (U32) channel, semitones, curved_velocity);
+    platform_midi_note_off(device, (U32) channel, semitones, curved_velocity);
 
-          Sound* const sound = &sim_palette[sound_index];
-          if (sound->samples) {
+  }
+}
 
-            ASSERT(sound->frames > 0);
+static U64 sim_clock(Void)
+{
+  return SDL_GetPerformanceCounter();
+}
 
-            // voice to initialize
-            SamplerVoice* const voice = &sim_sampler_voices[voice_index];
+static Void profile_reset(ModelProfile* profile)
+{
+  model_profile_clear(profile);
+  profile->clock = Config_PROFILE_TIMING ? sim_clock : NULL;
+  profile->frequency = SDL_GetPerformanceFrequency();
+}
 
-            // curved values
-            const F32 curved_attack =
-              sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * attack);
-            const F32 curved_hold =
-              sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * hold);
-            const F32 curved_release =
-              sim_envelope_coefficient * powf(SIM_EULER, sim_envelope_exponent * release);
+// Hand the window to the render thread once it is long enough. If the render
+// thread has no window to give back yet, keep accumulating.
+static Void profile_advance(SimInstance* s)
+{
+  s->profile_beats += 1;
+  if (s->profile_beats >= SIM_PROFILE_BEATS && ATOMIC_QUEUE_LENGTH(Index)(s->channel.profile_free_queue) > 0) {
+    const Index sentinel = -1;
+    const Index next = ATOMIC_QUEUE_DEQUEUE(Index)(s->channel.profile_free_queue, sentinel);
+    ASSERT(next != sentinel);
+    ATOMIC_QUEUE_ENQUEUE(Index)(s->channel.profile_queue, s->profile_head);
+    s->profile_head = next;
+    s->profile_beats = 0;
+    profile_reset(&s->history.profiles[s->profile_head]);
+  }
+}
 
-            // initialize envelope
-            sk_env_init(&voice->envelope, Config_AUDIO_SAMPLE_RATE);
-            sk_env_attack(&voice->envelope, curved_attack);
-            sk_env_hold(&voice->envelope, curved_hold);
-            sk_env_release(&voice->envelope, curved_release);
-            sk_env_tick(&voice->envelope, 1.f);
+static Void cycle_reset(SimInstance* s)
+{
+  s->cycle.tag = CYCLE_SEARCH;
+  s->cycle.power = 0;
+}
 
-            // initialize parameters
-            voice->start = offset;
-            voice->frame = 0;
-            voice->sound = sound_index;
-            voice->pitch = pitch - MODEL_RADIX / 2;
-            voice->volume = (F32) velocity / MODEL_RADIX;
+static Void cycle_snapshot(SimInstance* s, const Model* m)
+{
+  model_chunk_copy(m->index, m->dimensions, s->history.snapshot, m->memory);
+  s->cycle.registers = *m->register_file;
+  s->cycle.length = 0;
+  s->cycle.frame_period = 1;
+}
 
+// compare against the snapshot, ignoring the frame counter
+static Bool cycle_closed(const SimInstance* s, const Model* m)
+{
+  const Cycle* const cycle = &s->cycle;
+  const RegisterFile* const rf = m->register_file;
+  if (rf->hash != cycle->registers.hash) {
+    return false;
+  }
+  const Bool frame = cycle->frame_period != 0 && cycle->length % cycle->frame_period == 0;
+  const Bool rnd = memcmp(&rf->rnd, &cycle->registers.rnd, sizeof(rf->rnd)) == 0;
+  const Bool registers = memcmp(rf->registers, cycle->registers.registers, sizeof(rf->registers)) == 0;
+  return frame && rnd && registers && model_chunk_equal(m->index, m->dimensions, m->memory, s->history.snapshot);
+}
+
+// note the writes and registers of a recorded beat
+static Void cycle_record(SimInstance* s, const Model* m)
+{
+  Cycle* const cycle = &s->cycle;
+  Index head = cycle->write_heads[cycle->beat];
+  for (S32 y = 0; y < m->dimensions.y; y++) {
+    S32 begin = 0;
+    S32 end = 0;
+    while (model_chunk_run(m->index, m->dimensions, y, &begin, &end)) {
+      const Index row = MODEL_OFFSET(m->dimensions, 0, y);
+      for (Index i = row + begin; i < row + end; i++) {
+        if (m->memory[i] != s->history.previous[i]) {
+          if (head == SIM_CYCLE_WRITES) {
+            cycle_reset(s);
+            return;
           }
+          cycle->writes[head].offset = (S32) i;
+          cycle->writes[head].cell = m->memory[i];
+          s->history.previous[i] = m->memory[i];
+          head += 1;
         }
       }
+    }
+  }
+  cycle->register_files[cycle->beat] = *m->register_file;
+  cycle->beat += 1;
+  cycle->write_heads[cycle->beat] = head;
+}
 
-      // process midi event
-      if (value.tag == VALUE_MIDI && bang) {
+static Void cycle_replay(SimInstance* s, Model* m)
+{
+  Cycle* const cycle = &s->cycle;
+  RegisterFile* const rf = m->register_file;
+  const Index beat = cycle->beat;
+
+  // apply memory writes
+  for (Index i = cycle->write_heads[beat]; i < cycle->write_heads[beat + 1]; i++) {
+    const CycleWrite write = cycle->writes[i];
+    model_set(m, model_point(m->dimensions, write.offset), value_of_cell(write.cell));
+  }
 
-        // parameter values
-        const S32 octave    = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 5))), 0);
-        const S32 pitch     = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 4))), 0);
-        const S32 velocity  = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 3))), 0);
-        const S32 channel   = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 2))), 0);
-        const S32 device    = read_literal(model_get(m, v2s_add(origin, v2s_scale(west, 1))), 0);
+  // restore registers, keeping the frame counter running
+  const Index frame = rf->frame;
+  *rf = cycle->register_files[beat];
+  rf->frame = frame + 1;
 
-        // curved values
-        const U32 semitones = OCTAVE * (U32) octave + (U32) pitch;
-        const U32 curved_velocity = 3 * (U32) velocity;
+  for (Index i = cycle->trigger_heads[beat]; i < cycle->trigger_heads[beat + 1]; i++) {
+    sim_trigger(s, &cycle->triggers[i]);
+  }
+
+  cycle->beat = (beat + 1) % cycle->period;
+}
+
+static Void sim_step_model(SimInstance* s, Model* m)
+{
+  Cycle* const cycle = &s->cycle;
+  EventSink* const events = &s->events;
+
+  if (cycle->tag == CYCLE_REPLAY) {
+    cycle_replay(s, m);
+    return;
+  }
 
-        // send midi message
-        platform_midi_note_on(device, (U32) channel, semitones, curved_velocity);
-        platform_midi_note_off(device, (U32) channel, semitones, curved_velocity);
+  if (cycle->tag == CYCLE_SEARCH && cycle->power == 0) {
+    cycle_snapshot(s, m);
+    cycle->power = 1;
+  }
 
+  // The audio thread only evaluates. The render thread derives the graph
+  // from published snapshots when it needs one.
+  events->head = 0;
+  events->dropped = 0;
+  m->frame_period = &cycle->frame_period;
+  model_step(m, NULL, events);
+  m->frame_period = NULL;
+  cycle->length += 1;
+
+  // events carry their operands, so starting voices needs no grid reads
+  for (Index i = 0; i < events->head; i++) {
+    const ModelEvent* const event = &events->events[i];
+    sim_trigger(s, event);
+    if (cycle->tag == CYCLE_RECORD) {
+      const Index head = cycle->trigger_heads[cycle->beat + 1];
+      if (head < SIM_CYCLE_TRIGGERS) {
+        cycle->triggers[head] = *event;
+        cycle->trigger_heads[cycle->beat + 1] = head + 1;
+      } else {
+        cycle_reset(s);
       }
     }
   }
+
+  switch (cycle->tag) {
+
+    case CYCLE_SEARCH:
+      {
+        if (cycle->power == 0) {
+          // restarted during this beat
+        } else if (cycle_closed(s, m)) {
+          // evaluate one more period to record it
+          cycle->tag = CYCLE_RECORD;
+          cycle->period = cycle->length;
+          cycle->beat = 0;
+          cycle->write_heads[0] = 0;
+          cycle->trigger_heads[0] = 0;
+          cycle->trigger_heads[1] = 0;
+          model_chunk_copy(m->index, m->dimensions, s->history.previous, m->memory);
+          cycle_snapshot(s, m);
+        } else if (cycle->length == cycle->power) {
+          cycle->power = MIN(2 * cycle->power, SIM_CYCLE_BEATS);
+          cycle_snapshot(s, m);
+        }
+      } break;
+
+    case CYCLE_RECORD:
+      {
+        cycle_record(s, m);
+        if (cycle->tag != CYCLE_RECORD) {
+          // ran out of room
+        } else if (cycle->beat < cycle->period) {
+          cycle->trigger_heads[cycle->beat + 1] = cycle->trigger_heads[cycle->beat];
+        } else if (cycle_closed(s, m)) {
+          cycle->tag = CYCLE_REPLAY;
+          cycle->beat = 0;
+        } else {
+          cycle_reset(s);
+        }
+      } break;
+
+    default: { }
+  }
 }
 
-static Void sim_step_synth_voice(Index voice_index, F32* out, Index frames)
+// add a synth voice to a mono block
+static Void sim_step_synth_voice(SimInstance* s, Index voice_index, F32* out, Index frames)
 {
   ASSERT(voice_index != INDEX_NONE);
-  SynthVoice* const voice = &sim_synth_voices[voice_index];
-  const F32 hz = to_hz((F32) voice->pitch);
+  ASSERT(frames <= SIM_BLOCK);
+  SynthVoice* const voice = &s->synth_voices[voice_index];
 
-  for (Index i = 0; i < frames; i++) {
-    const F32 volume = sk_env_tick(&voice->envelope, 0);
-    const Index current_frame = voice->frame + i;
-    const F32 sample = sinf(hz * SIM_PI * current_frame / Config_AUDIO_SAMPLE_RATE);
-    out[STEREO * i + 0] += sample * volume * voice->volume;
-    out[STEREO * i + 1] += sample * volume * voice->volume;
-  }
+  F32 gain[SIM_BLOCK];
+  envelope_render(&voice->envelope, voice->volume, gain, frames);
+  oscillate(voice->table, voice->phase, voice->increment, gain, out, frames);
 
-  voice->frame += frames;
-  if (voice->envelope.mode == 0) {
-    clear_synth_voice(voice_index);
+  voice->phase += (U32) frames * voice->increment;
+  if (voice->envelope.stage == ENVELOPE_OFF) {
+    clear_synth_voice(s, voice_index);
   }
 }
 
-static F32 sim_sampler_voice_frame(const SamplerVoice* voice, Index length)
+// Add a looping sound to a stereo block, starting at `*head` and advancing
+// `rate` frames per output frame. Spans that end before the last frame of the
+// sound never wrap, so they read the next frame directly, and only the frames
+// that straddle the wrap take the modulo. A vector holds two stereo frames.
+static Void resample(const Sound* sound, F64* head, F64 rate, const F32* gain, F32* out, Index frames)
 {
-  const Index start = (voice->start * length) / MODEL_RADIX;
-  const F32 rate = powf(SIM_TWELFTH_ROOT_TWO, (F32) voice->pitch);
-  const F32 head = start + (rate * voice->frame);
-  return fmodf(head, (F32) length);
+  const F32* const samples = sound->samples;
+  const Index length = sound->frames;
+  F64 h = *head;
+  Index i = 0;
+  while (i < frames) {
+
+    // Stay a whole step short of the last frame, so rounding can't reach it.
+    const F64 room = (F64) (length - 1) - h;
+    const Index span = MIN(frames - i, room > 0.0 ? (Index) (room / rate) : 0);
+    Index n = 0;
+#if SIMD
+    for (; n + 2 <= span; n += 2) {
+      const F64 p0 = h + (F64) n * rate;
+      const F64 p1 = h + (F64) (n + 1) * rate;
+      const Index s0 = (Index) p0;
+      const Index s1 = (Index) p1;
+      const F32 f0 = (F32) (p0 - (F64) s0);
+      const F32 f1 = (F32) (p1 - (F64) s1);
+      const F32* const a = &samples[STEREO * s0];
+      const F32* const b = &samples[STEREO * s1];
+      const F32x4 current = f32x4_set(a[0], a[1], b[0], b[1]);
+      const F32x4 next = f32x4_set(a[2], a[3], b[2], b[3]);
+      const F32x4 fraction = f32x4_set(f0, f0, f1, f1);
+      const F32x4 g = f32x4_set(gain[i + n], gain[i + n], gain[i + n + 1], gain[i + n + 1]);
+      const F32x4 lerp = f32x4_add(
+          f32x4_mul(f32x4_sub(f32x4_splat(1.f), fraction), current),
+          f32x4_mul(fraction, next));
+      F32* const o = &out[STEREO * (i + n)];
+      f32x4_store(o, f32x4_add(f32x4_load(o), f32x4_mul(g, lerp)));
+    }
+#endif
+    for (; n < span; n++) {
+      const F64 position = h + (F64) n * rate;
+      const Index src = (Index) position;
+      const F32 fraction = (F32) (position - (F64) src);
+      const F32 lhs = f32_lerp(samples[STEREO * src + 0], samples[STEREO * src + 2], fraction);
+      const F32 rhs = f32_lerp(samples[STEREO * src + 1], samples[STEREO * src + 3], fraction);
+      out[STEREO * (i + n) + 0] += gain[i + n] * lhs;
+      out[STEREO * (i + n) + 1] += gain[i + n] * rhs;
+    }
+    h += (F64) span * rate;
+    i += span;
+
+    // the frame across the wrap
+    if (i < frames) {
+      const Index src = (Index) h;
+      const Index dst = (src + 1) % length;
+      const F32 fraction = (F32) (h - (F64) src);
+      const F32 lhs = f32_lerp(samples[STEREO * src + 0], samples[STEREO * dst + 0], fraction);
+      const F32 rhs = f32_lerp(samples[STEREO * src + 1], samples[STEREO * dst + 1], fraction);
+      out[STEREO * i + 0] += gain[i] * lhs;
+      out[STEREO * i + 1] += gain[i] * rhs;
+      h = fmod(h + rate, (F64) length);
+      i += 1;
+    }
+  }
+  *head = h;
 }
 
-static Void sim_step_sampler_voice(Index voice_index, F32* out, Index frames)
+static Void sim_step_sampler_voice(SimInstance* s, Index voice_index, F32* out, Index frames)
 {
   ASSERT(voice_index != INDEX_NONE);
-  SamplerVoice* const voice = &sim_sampler_voices[voice_index];
+  ASSERT(frames <= SIM_BLOCK);
+  SamplerVoice* const voice = &s->sampler_voices[voice_index];
   const Sound* const sound = &sim_palette[voice->sound];
 
   // We check this here because the palette can change.
   if (sound->samples) {
     ASSERT(sound->frames > 0);
-    for (Index i = 0; i < frames; i++) {
-
-      const F32 volume = sk_env_tick(&voice->envelope, 0) * voice->volume;
-      const F32 playhead = sim_sampler_voice_frame(voice, sound->frames);
-
-      // decompose
-      F32 integral = 0.f;
-      const F32 fractional = modff(playhead, &integral);
-
-      const Index src = (Index) integral;
-      const Index dst = (src + 1) % sound->frames;
-
-      const F32 lhs = f32_lerp(
-          sound->samples[STEREO * src + 0],
-          sound->samples[STEREO * dst + 0],
-          fractional);
-      const F32 rhs = f32_lerp(
-          sound->samples[STEREO * src + 1],
-          sound->samples[STEREO * dst + 1],
-          fractional);
-
-      out[STEREO * i + 0] += volume * lhs;
-      out[STEREO * i + 1] += volume * rhs;
-      voice->frame += 1;
-
+    if (voice->head >= (F64) sound->frames) {
+      voice->head = fmod(voice->head, (F64) sound->frames);
     }
+
+    F32 gain[SIM_BLOCK];
+    envelope_render(&voice->envelope, voice->volume, gain, frames);
+    resample(sound, &voice->head, voice->rate, gain, out, frames);
   }
 
-  if (voice->envelope.mode == 0) {
-    clear_sampler_voice(voice_index);
+  if (voice->envelope.stage == ENVELOPE_OFF) {
+    clear_sampler_voice(s, voice_index);
   }
 }
 
-static Void sim_partial_step(F32* audio_out, Index frames)
+static Void sim_partial_step(SimInstance* s, F32* audio_out, Index frames)
 {
   for (Index i = 0; i < frames; i++) {
     audio_out[STEREO * i + 0] = 0.f;
     audio_out[STEREO * i + 1] = 0.f;
   }
 
-  // update synth voices
-  for (Index i = 0; i < SIM_VOICES; i++) {
-    SynthVoice* const voice = &sim_synth_voices[i];
-    if (voice->envelope.mode) {
-      sim_step_synth_voice(i, audio_out, frames);
-    }
+  // Update synth voices, which are mono, into one buffer. A voice that ends
+  // swaps the last active voice into its place, so these loops run backwards
+  // over the ones already stepped.
+  F32 synth[SIM_BLOCK];
+  memset(synth, 0, frames * sizeof(F32));
+  for (Index i = s->synth_voice_active_count - 1; i >= 0; i--) {
+    sim_step_synth_voice(s, s->synth_voice_active[i], synth, frames);
+  }
+  for (Index i = 0; i < frames; i++) {
+    audio_out[STEREO * i + 0] += synth[i];
+    audio_out[STEREO * i + 1] += synth[i];
   }
 
   // update sampler voices
-  for (Index i = 0; i < SIM_VOICES; i++) {
-    SamplerVoice* const voice = &sim_sampler_voices[i];
-    if (voice->sound != INDEX_NONE) {
-      sim_step_sampler_voice(i, audio_out, frames);
-    }
+  for (Index i = s->sampler_voice_active_count - 1; i >= 0; i--) {
+    sim_step_sampler_voice(s, s->sampler_voice_active[i], audio_out, frames);
   }
 
-  sim_frame += frames;
+  s->frame += frames;
 }
 
-Void sim_step(F32* audio_out, Index frames)
+// whether a beat falls within the next `frames` frames
+static Bool beat_due(const SimInstance* s, Index frames)
 {
-  // clear the output buffer
-  memset(audio_out, 0, STEREO * frames * sizeof(F32));
+  const Index period = bpm_to_period(s->tempo);
+  const Index residue = s->frame % period;
+  return s->pause == false && (residue == 0 || period - residue < frames);
+}
 
-  Index nxt_head = INDEX_NONE;
-  if (ATOMIC_QUEUE_LENGTH(Index)(&free_queue) > 0) {
+// Take a history slot for this period and apply the render thread's
+// messages. Messages reach shared state like the palette, so this runs on
+// the audio thread for every instance before any of them render.
+static Void instance_begin(SimInstance* s, Index frames)
+{
+  const SimChannel* const channel = &s->channel;
+
+  // Memory only changes on a beat or a message. Without either, the slot
+  // last published is still current, so nothing is copied or published. A
+  // period written to the backup is published once a slot is free.
+  const Index messages = (Index) ATOMIC_QUEUE_LENGTH(ControlMessage)(channel->control_queue);
+  s->publish = messages > 0 || beat_due(s, frames) || s->head == INDEX_NONE;
+
+  s->next_head = s->publish ? INDEX_NONE : s->head;
+  if (s->publish && ATOMIC_QUEUE_LENGTH(Index)(channel->free_queue) > 0) {
     const Index sentinel = -1;
-    nxt_head = ATOMIC_QUEUE_DEQUEUE(Index)(&free_queue, sentinel);
-    ASSERT(nxt_head != sentinel);
+    s->next_head = ATOMIC_QUEUE_DEQUEUE(Index)(channel->free_queue, sentinel);
+    ASSERT(s->next_head != sentinel);
   }
 
-  const ProgramHistory last = lookup_history_index(sim_head);
-  ProgramHistory next = lookup_history_index(nxt_head);
-  const Index area = sim_history.dimensions.x * sim_history.dimensions.y;
-
-  if (last.memory != next.memory) {
-    memcpy(next.register_file , last.register_file  , sizeof(RegisterFile));
-    memcpy(next.memory        , last.memory         , area * sizeof(Value));
-    memcpy(next.graph         , last.graph          , GRAPH_FACTOR * area * sizeof(GraphEdge));
+  const ProgramHistory last = lookup_history_index(s, s->head);
+  s->next = lookup_history_index(s, s->next_head);
+  // Every slot is empty outside the chunks the index has marked, so only
+  // those need copying.
+  if (last.memory != s->next.memory) {
+    memcpy(s->next.register_file , last.register_file  , sizeof(RegisterFile));
+    model_chunk_copy(&s->history.index, s->history.dimensions, s->next.memory, last.memory);
   }
 
-  // the current dsp state
-  DSPState backup_dsp = {0};
-  DSPState* const dsp_state = nxt_head >= 0 ? &dsp_history[nxt_head] : &backup_dsp;
+  // the voices move every period, so the dsp state has slots of its own
+  s->dsp_head = INDEX_NONE;
+  if (ATOMIC_QUEUE_LENGTH(Index)(channel->dsp_free_queue) > 0) {
+    const Index sentinel = -1;
+    s->dsp_head = ATOMIC_QUEUE_DEQUEUE(Index)(channel->dsp_free_queue, sentinel);
+    ASSERT(s->dsp_head != sentinel);
+  }
+  s->dsp_state = s->dsp_head >= 0 ? &channel->dsp_history[s->dsp_head] : &s->backup_dsp;
 
-  // process input messages
-  while (ATOMIC_QUEUE_LENGTH(ControlMessage)(&control_queue) > 0) {
+  // Process the messages counted above. Any that arrive since then wait for
+  // the next period, since this one may be writing the slot already shared.
+  for (Index m = 0; m < messages; m++) {
 
     // pull a message off the queue
     ControlMessage sentinel = {0};
-    const ControlMessage message = ATOMIC_QUEUE_DEQUEUE(ControlMessage)(&control_queue, sentinel);
+    const ControlMessage message = ATOMIC_QUEUE_DEQUEUE(ControlMessage)(channel->control_queue, sentinel);
     ASSERT(message.tag != CONTROL_MESSAGE_NONE);
 
+    // any outside change ends a cycle
+    cycle_reset(s);
+
     // process the message
     switch (message.tag) {
 
       case CONTROL_MESSAGE_WRITE:
         {
           Model model = {
-            .dimensions = sim_history.dimensions,
-            .register_file = next.register_file,
-            .memory = next.memory,
+            .dimensions = s->history.dimensions,
+            .register_file = s->next.register_file,
+            .memory = s->next.memory,
+            .index = &s->history.index,
+            .program = &s->history.program,
           };
+          undo_before(&model, &message.undo);
           model_set(&model, message.write.point, message.write.value);
+          undo_after(&model, &message.undo);
         } break;
 
       case CONTROL_MESSAGE_POWER:
         {
           Model model = {
-            .dimensions = sim_history.dimensions,
-            .register_file = next.register_file,
-            .memory = next.memory,
+            .dimensions = s->history.dimensions,
+            .register_file = s->next.register_file,
+            .memory = s->next.memory,
+            .index = &s->history.index,
+            .program = &s->history.program,
           };
           const V2S c = message.power.point;
-          Value* const value = &MODEL_INDEX(&model, c.x, c.y);
-          if (is_operator(*value)) {
-            value->powered = ! value->powered;
+          Value value = model_get(&model, c);
+          undo_before(&model, &message.undo);
+          if (is_operator(value)) {
+            value.powered = ! value.powered;
+            model_set(&model, c, value);
           }
+          undo_after(&model, &message.undo);
         } break;
 
       case CONTROL_MESSAGE_SOUND:
@@ -503,21 +1183,21 @@ Void sim_step(F32* audio_out, Index frames)
       case CONTROL_MESSAGE_TEMPO:
         {
           ASSERT(message.tempo > 0);
-          sim_tempo = message.tempo;
+          s->tempo = message.tempo;
         } break;
 
       case CONTROL_MESSAGE_MEMORY_RESIZE:
         {
-          // @rdk: Don't forget to send a message back to the render thread.
           const ResizeMessage* const msg = &message.resize;
-          const ProgramHistory previous = next;
+          const ProgramHistory previous = s->next;
+          const ControlMessage retired = control_message_memory_resize(s->history, s->backup);
           ASSERT(msg->primary.dimensions.x > 0);
           ASSERT(msg->primary.dimensions.y > 0);
           ASSERT(v2s_equal(msg->primary.dimensions, msg->secondary.dimensions));
-          sim_history = msg->primary;
-          sim_backup = msg->secondary;
-          next = lookup_history_index(nxt_head);
-          memcpy(next.register_file, previous.register_file, sizeof(RegisterFile));
+          s->history = msg->primary;
+          s->backup = msg->secondary;
+          s->next = lookup_history_index(s, s->next_head);
+          memcpy(s->next.register_file, previous.register_file, sizeof(RegisterFile));
 
           Model pm = {
             .dimensions = previous.dimensions,
@@ -526,31 +1206,62 @@ Void sim_step(F32* audio_out, Index frames)
           };
 
           Model nm = {
-            .dimensions = next.dimensions,
-            .register_file = next.register_file,
-            .memory = next.memory,
+            .dimensions = s->next.dimensions,
+            .register_file = s->next.register_file,
+            .memory = s->next.memory,
+            .index = &s->history.index,
+            .program = &s->history.program,
           };
 
-          for (Index y = 0; y < MIN(previous.dimensions.y, next.dimensions.y); y++) {
-            for (Index x = 0; x < MIN(previous.dimensions.x, next.dimensions.x); x++) {
+          for (Index y = 0; y < MIN(previous.dimensions.y, s->next.dimensions.y); y++) {
+            for (Index x = 0; x < MIN(previous.dimensions.x, s->next.dimensions.x); x++) {
               MODEL_INDEX(&nm, x, y) = MODEL_INDEX(&pm, x, y);
             }
           }
+          model_index_rebuild(&nm);
+          nm.register_file->hash = model_hash(&nm);
+
+          // the window being accumulated moves to the new history
+          s->profile_beats = 0;
+          profile_reset(&s->history.profiles[s->profile_head]);
+
+          // the snapshot moves too, so the search for a cycle starts over
+          cycle_reset(s);
+          s->requested = 0;
+
+          // nothing reads the old histories past this point
+          ATOMIC_QUEUE_ENQUEUE(ControlMessage)(channel->retire_queue, retired);
         } break;
 
       case CONTROL_MESSAGE_CLEAR:
         {
           Model model = {
-            .dimensions = sim_history.dimensions,
-            .register_file = next.register_file,
-            .memory = next.memory,
+            .dimensions = s->history.dimensions,
+            .register_file = s->next.register_file,
+            .memory = s->next.memory,
+            .index = &s->history.index,
+            .program = &s->history.program,
           };
+          undo_before(&model, &message.undo);
           model_init(&model);
+          undo_after(&model, &message.undo);
         } break;
 
       case CONTROL_MESSAGE_PAUSE:
         {
-          sim_pause = ! sim_pause;
+          s->pause = ! s->pause;
+        } break;
+
+      case CONTROL_MESSAGE_RESTORE:
+        {
+          Model model = {
+            .dimensions = s->history.dimensions,
+            .register_file = s->next.register_file,
+            .memory = s->next.memory,
+            .index = &s->history.index,
+            .program = &s->history.program,
+          };
+          undo_restore(&model, &message.restore.step, message.restore.forward);
         } break;
 
       default: { }
@@ -558,24 +1269,104 @@ Void sim_step(F32* audio_out, Index frames)
     }
 
   }
+}
+
+// compute the audio for one block, into the instance's own buffer
+static Void instance_render(SimInstance* s, Index frames)
+{
+  // With several instances the workers are stepping instances, so each one
+  // evaluates its lanes in turn.
+  const Bool lanes = sim_instance_count == 1 && sim_pool.run;
 
-  // compute the audio for this period
-  const Index period = bpm_to_period(sim_tempo);
+  const Index period = bpm_to_period(s->tempo);
   Index elapsed = 0;
   while (elapsed < frames) {
-    const Index residue = sim_frame % period;
+    const Index residue = s->frame % period;
     const Index delta = MIN(period - residue, frames - elapsed);
-    if (sim_pause == false && residue == 0) {
+    if (s->pause == false && residue == 0) {
       Model model = {
-        .dimensions = sim_history.dimensions,
-        .register_file = next.register_file,
-        .memory = next.memory,
+        .dimensions = s->history.dimensions,
+        .register_file = s->next.register_file,
+        .memory = s->next.memory,
+        .index = &s->history.index,
+        .program = &s->history.program,
+        .pool = lanes ? &sim_pool : NULL,
+        .profile = &s->history.profiles[s->profile_head],
       };
-      sim_step_model(&model, next.graph);
+      sim_step_model(s, &model);
+      profile_advance(s);
     }
-    sim_partial_step(audio_out + STEREO * elapsed, delta);
+    sim_partial_step(s, s->audio + STEREO * elapsed, delta);
     elapsed += delta;
   }
+}
+
+static Void instance_render_task(Void* arg, Index lane)
+{
+  const Index frames = *(const Index*) arg;
+  for (Index i = lane; i < sim_instance_count; i += MODEL_LANES) {
+    instance_render(&sim_instances[i], frames);
+  }
+}
+
+// publish the dsp state and history slot written this period
+static Void instance_end(SimInstance* s)
+{
+  DSPState* const dsp_state = s->dsp_state;
+  dsp_state->tempo = s->tempo;
+  dsp_state->voice_count = s->sampler_voice_active_count;
+  for (Index i = 0; i < s->sampler_voice_active_count; i++) {
+    const SamplerVoice* const voice = &s->sampler_voices[s->sampler_voice_active[i]];
+    dsp_state->voices[i].sound = voice->sound;
+    dsp_state->voices[i].frame = (F32) voice->head;
+    dsp_state->voices[i].length = sim_palette[voice->sound].frames;
+  }
+
+  // update shared pointers
+  if (s->dsp_head >= 0) {
+    ATOMIC_QUEUE_ENQUEUE(Index)(s->channel.dsp_queue, s->dsp_head);
+  }
+  if (s->publish && s->next_head >= 0) {
+    ATOMIC_QUEUE_ENQUEUE(Index)(s->channel.allocation_queue, s->next_head);
+  }
+  s->head = s->next_head;
+
+  // A program too long for its buffers is interpreted. Ask once for a
+  // history with room for it, which arrives as a resize.
+  const ModelProgram* const program = &s->history.program;
+  if (program->operators > program->capacity && program->operators > s->requested) {
+    s->requested = program->operators;
+    ATOMIC_QUEUE_ENQUEUE(ControlMessage)(s->channel.retire_queue, control_message_capacity(program->operators));
+  }
+}
+
+Void sim_step(F32* audio_out, Index frames)
+{
+  // clear the output buffer
+  memset(audio_out, 0, STEREO * frames * sizeof(F32));
+
+  for (Index i = 0; i < sim_instance_count; i++) {
+    instance_begin(&sim_instances[i], frames);
+  }
+
+  // render the instances side by side, then mix them
+  for (Index elapsed = 0; elapsed < frames; elapsed += SIM_BLOCK) {
+    Index block = MIN(SIM_BLOCK, frames - elapsed);
+    if (sim_instance_count > 1 && sim_pool.run) {
+      sim_pool.run(sim_pool.context, instance_render_task, &block, MIN(sim_instance_count, MODEL_LANES));
+    } else {
+      for (Index i = 0; i < sim_instance_count; i++) {
+        instance_render(&sim_instances[i], block);
+      }
+    }
+    F32* const out = audio_out + STEREO * elapsed;
+    for (Index i = 0; i < sim_instance_count; i++) {
+      const F32* const in = sim_instances[i].audio;
+      for (Index j = 0; j < STEREO * block; j++) {
+        out[j] += in[j];
+      }
+    }
+  }
 
   // reverberate
   if (sim_reverb_status) {
@@ -597,29 +1388,9 @@ Void sim_step(F32* audio_out, Index frames)
     audio_out[2 * i + 1] *= sim_global_volume;
   }
 
-  // write dsp visualization data
-  dsp_state->tempo = sim_tempo;
-  for (Index i = 0; i < SIM_VOICES; i++) {
-    const SamplerVoice* const voice = &sim_sampler_voices[i];
-    if (voice->sound != INDEX_NONE) {
-      const Index length = sim_palette[voice->sound].frames;
-      dsp_state->voices[i].active = true;
-      dsp_state->voices[i].sound = voice->sound;
-      dsp_state->voices[i].frame = sim_sampler_voice_frame(voice, length);
-      dsp_state->voices[i].length = length;
-    } else {
-      dsp_state->voices[i].active = false;
-      dsp_state->voices[i].frame = 0;
-      dsp_state->voices[i].length = 0;
-      dsp_state->voices[i].sound = INDEX_NONE;
-    }
-  }
-
-  // update shared pointer
-  if (nxt_head >= 0) {
-    ATOMIC_QUEUE_ENQUEUE(Index)(&allocation_queue, nxt_head);
+  for (Index i = 0; i < sim_instance_count; i++) {
+    instance_end(&sim_instances[i]);
   }
-  sim_head = nxt_head;
 }
 
 #if 0
@@ -776,30 +1547,150 @@ Void sim_step(F32* audio_out, Index frames)
 }
 #endif
 
-Void sim_init(ProgramHistory primary, ProgramHistory secondary)
+Index sim_beat_frames(Index instance)
+{
+  ASSERT(instance >= 0 && instance < sim_instance_count);
+  return bpm_to_period(sim_instances[instance].tempo);
+}
+
+ProgramHistory sim_allocate_history(S32 length, V2S dimensions, Index operators)
+{
+  // room to grow, since operators come and go as the program runs
+  const Index capacity = MAX(2 * operators, SIM_PROGRAM_CAPACITY);
+  Index slots = 1;
+  while (slots < 2 * capacity) {
+    slots *= 2;
+  }
+
+  ProgramHistory history;
+  history.dimensions = dimensions;
+  const S32 cells = MODEL_CELLS(dimensions);
+  const Index words = model_index_words(dimensions);
+  history.register_file = SDL_calloc(length, sizeof(RegisterFile));
+  history.memory = SDL_calloc(length, cells * sizeof(Cell));
+  history.index.stride = 0;
+  history.index.active = SDL_calloc(words, sizeof(U64));
+  history.index.bangs = SDL_calloc(words, sizeof(U64));
+  history.index.adjacent = SDL_calloc(words, sizeof(U64));
+  history.index.chunk_stride = 0;
+  history.index.chunks = SDL_calloc(model_chunk_words(dimensions), sizeof(U64));
+  history.program.valid = false;
+  history.program.length = 0;
+  history.program.capacity = capacity;
+  history.program.operators = 0;
+  history.program.instructions = SDL_calloc(capacity, sizeof(Instruction));
+  history.program.cursor = INDEX_NONE;
+  history.program.pending_head = 0;
+  history.program.pending_length = 0;
+  history.program.pending = SDL_calloc(capacity, sizeof(Index));
+  history.program.lanes = 0;
+  history.program.partition = SDL_calloc(words + capacity, sizeof(Index));
+  history.snapshot = SDL_calloc(cells, sizeof(Cell));
+  history.previous = SDL_calloc(cells, sizeof(Cell));
+  history.profiles = SDL_calloc(SIM_PROFILES, sizeof(ModelProfile));
+  ASSERT(history.profiles);
+  for (Index i = 0; i < SIM_PROFILES; i++) {
+    history.profiles[i].capacity = slots;
+    history.profiles[i].tiles = SDL_calloc(slots, sizeof(Index));
+    history.profiles[i].cells = SDL_calloc(slots, sizeof(ProfileCounter));
+    ASSERT(history.profiles[i].tiles);
+    ASSERT(history.profiles[i].cells);
+    model_profile_clear(&history.profiles[i]);
+  }
+  ASSERT(history.register_file);
+  ASSERT(history.memory);
+  ASSERT(history.index.active);
+  ASSERT(history.index.bangs);
+  ASSERT(history.index.adjacent);
+  ASSERT(history.index.chunks);
+  ASSERT(history.program.instructions);
+  ASSERT(history.program.pending);
+  ASSERT(history.program.partition);
+  ASSERT(history.snapshot);
+  ASSERT(history.previous);
+  return history;
+}
+
+ProgramHistory sim_allocate_secondary(V2S dimensions)
 {
-  sim_history = primary;
-  sim_backup = secondary;
+  ProgramHistory history = {0};
+  history.dimensions = dimensions;
+  history.register_file = SDL_calloc(1, sizeof(RegisterFile));
+  history.memory = SDL_calloc(MODEL_CELLS(dimensions), sizeof(Cell));
+  ASSERT(history.register_file);
+  ASSERT(history.memory);
+  return history;
+}
+
+Void sim_free_history(ProgramHistory* history)
+{
+  if (history->profiles) {
+    for (Index i = 0; i < SIM_PROFILES; i++) {
+      SDL_free(history->profiles[i].cells);
+      SDL_free(history->profiles[i].tiles);
+    }
+  }
+  SDL_free(history->profiles);
+  SDL_free(history->previous);
+  SDL_free(history->snapshot);
+  SDL_free(history->program.partition);
+  SDL_free(history->program.pending);
+  SDL_free(history->program.instructions);
+  SDL_free(history->index.chunks);
+  SDL_free(history->index.adjacent);
+  SDL_free(history->index.bangs);
+  SDL_free(history->index.active);
+  SDL_free(history->memory);
+  SDL_free(history->register_file);
+  *history = (ProgramHistory) {0};
+}
 
+Void sim_init(Void)
+{
   // initialize midi subsystem
   platform_midi_init();
 
-  // fill voice indices
-  for (Index i = 0; i < SIM_VOICES; i++) {
-    clear_synth_voice(i);
-    clear_sampler_voice(i);
+  // start evaluation workers
+  if (worker_init()) {
+    sim_pool.context = &sim_workers;
+    sim_pool.run = worker_run;
   }
 
+  // oscillator and envelope tables
+  build_wavetables();
+  build_envelope_tables();
+
   // initialize sndkit bigverb
   sim_bigverb = sk_bigverb_new(Config_AUDIO_SAMPLE_RATE);
   ASSERT(sim_bigverb);
   sk_bigverb_size(sim_bigverb, REVERB_DEFAULT_SIZE);
   sk_bigverb_cutoff(sim_bigverb, REVERB_DEFAULT_CUTOFF);
+}
+
+Index sim_attach(SimChannel channel, ProgramHistory primary, ProgramHistory secondary)
+{
+  if (sim_instance_count == SIM_INSTANCES) {
+    return INDEX_NONE;
+  }
+
+  const Index instance = sim_instance_count;
+  SimInstance* const s = &sim_instances[instance];
+  *s = (SimInstance) {0};
+  s->channel = channel;
+  s->history = primary;
+  s->backup = secondary;
+  s->tempo = SIM_DEFAULT_TEMPO;
+  s->events = (EventSink) { SIM_EVENTS, 0, 0, s->event_buffer };
 
-  // initialize voice envelopes
+  // start the first profile window
+  profile_reset(&s->history.profiles[s->profile_head]);
+
+  // fill voice indices
   for (Index i = 0; i < SIM_VOICES; i++) {
-    SynthVoice* const synth_voice = &sim_synth_voices[i];
-    sk_env_init(&synth_voice->envelope, Config_AUDIO_SAMPLE_RATE);
+    clear_synth_voice(s, i);
+    clear_sampler_voice(s, i);
   }
-}
 
+  sim_instance_count += 1;
+  return instance;
+}
@@ -0,0 +1,294 @@
+#include <string.h>
+#include <SDL3/SDL_stdinc.h>
+#include "tape.h"
+
+// the most bytes a varint of an Index takes
+#define TAPE_VARINT 10
+
+static TapeEntry* entry_at(const Tape* tape, Index sequence)
+{
+  return &tape->entries[sequence % TAPE_BEATS];
+}
+
+static Index entry_bound(V2S dimensions)
+{
+  const Index area = dimensions.x * dimensions.y;
+  const Index changes = (area + MODEL_RADIX) * (TAPE_VARINT + sizeof(Cell));
+  return 2 * TAPE_VARINT + changes + sizeof(rnd_pcg_t) + sizeof(U64);
+}
+
+static U8* put_varint(U8* out, Index value)
+{
+  U64 v = (U64) value;
+  while (v >= 0x80) {
+    *out++ = (U8) (v | 0x80);
+    v >>= 7;
+  }
+  *out++ = (U8) v;
+  return out;
+}
+
+static const U8* get_varint(const U8* in, Index* value)
+{
+  U64 v = 0;
+  S32 shift = 0;
+  while (*in & 0x80) {
+    v |= (U64) (*in++ & 0x7F) << shift;
+    shift += 7;
+  }
+  v |= (U64) *in++ << shift;
+  *value = (Index) v;
+  return in;
+}
+
+static U8* put_cell(U8* out, Cell cell)
+{
+  *out++ = (U8) cell;
+  *out++ = (U8) (cell >> 8);
+  return out;
+}
+
+static const U8* get_cell(const U8* in, Cell* cell)
+{
+  *cell = (Cell) (in[0] | in[1] << 8);
+  return in + 2;
+}
+
+// Write the cells that differ from `previous`, as a count and then a gap and
+// a cell for each. Without a previous, every cell that is not empty differs.
+static U8* put_changes(U8* out, const Cell* cells, const Cell* previous, Index length)
+{
+  Index changes = 0;
+  for (Index i = 0; i < length; i++) {
+    changes += cells[i] != (previous ? previous[i] : 0);
+  }
+  out = put_varint(out, changes);
+  Index last = -1;
+  for (Index i = 0; i < length; i++) {
+    if (cells[i] != (previous ? previous[i] : 0)) {
+      out = put_varint(out, i - last - 1);
+      out = put_cell(out, cells[i]);
+      last = i;
+    }
+  }
+  return out;
+}
+
+// encode a beat, given one cell per tile, against the newest one recorded
+static Index encode(Tape* tape, const Cell* cells, const RegisterFile* rf, Bool keyframe, U8* out)
+{
+  const Index area = tape->dimensions.x * tape->dimensions.y;
+  U8* const begin = out;
+  out = put_changes(out, cells, keyframe ? NULL : tape->last, area);
+  out = put_changes(out, rf->registers, keyframe ? NULL : tape->last_registers.registers, MODEL_RADIX);
+  memcpy(out, &rf->rnd, sizeof(rf->rnd));
+  out += sizeof(rf->rnd);
+  memcpy(out, &rf->hash, sizeof(rf->hash));
+  out += sizeof(rf->hash);
+  return out - begin;
+}
+
+static Void decode(Tape* tape, const TapeEntry* entry)
+{
+  const V2S d = tape->dimensions;
+  const U8* in = &tape->bytes[entry->offset];
+  RegisterFile* const rf = &tape->view_registers;
+  if (entry->keyframe) {
+    memset(tape->view, 0, MODEL_CELLS(d) * sizeof(Cell));
+    memset(rf, 0, sizeof(*rf));
+  }
+
+  Index changes = 0;
+  Index tile = -1;
+  in = get_varint(in, &changes);
+  for (Index i = 0; i < changes; i++) {
+    Index gap = 0;
+    Cell cell = 0;
+    in = get_varint(in, &gap);
+    in = get_cell(in, &cell);
+    tile += gap + 1;
+    tape->view[MODEL_OFFSET(d, tile % d.x, tile / d.x)] = cell;
+  }
+
+  Index reg = -1;
+  in = get_varint(in, &changes);
+  for (Index i = 0; i < changes; i++) {
+    Index gap = 0;
+    in = get_varint(in, &gap);
+    reg += gap + 1;
+    in = get_cell(in, &rf->registers[reg]);
+  }
+
+  memcpy(&rf->rnd, in, sizeof(rf->rnd));
+  in += sizeof(rf->rnd);
+  memcpy(&rf->hash, in, sizeof(rf->hash));
+  rf->frame = entry->frame;
+}
+
+// Find room for an entry in the byte ring, dropping the oldest entries in the
+// way, and then any that no longer follow a keyframe.
+static Index claim(Tape* tape, Index length)
+{
+  const Bool wrap = tape->write + length > TAPE_BYTES;
+  const Index offset = wrap ? 0 : tape->write;
+  while (tape->first < tape->count) {
+    const TapeEntry* const e = entry_at(tape, tape->first);
+    const Bool overlaps = e->offset < offset + length && e->offset + e->length > offset;
+    const Bool abandoned = wrap && e->offset >= tape->write;
+    const Bool full = tape->count - tape->first == TAPE_BEATS;
+    if (overlaps == false && abandoned == false && full == false) {
+      break;
+    }
+    tape->first += 1;
+  }
+  while (tape->first < tape->count && entry_at(tape, tape->first)->keyframe == false) {
+    tape->first += 1;
+  }
+  return offset;
+}
+
+Tape tape_allocate(V2S dimensions)
+{
+  const Index area = dimensions.x * dimensions.y;
+  Tape tape = {0};
+  tape.dimensions = dimensions;
+  tape.entries = SDL_calloc(TAPE_BEATS, sizeof(TapeEntry));
+  tape.bytes = SDL_calloc(TAPE_BYTES, 1);
+  tape.scratch = SDL_calloc(entry_bound(dimensions), 1);
+  tape.current = SDL_calloc(area, sizeof(Cell));
+  tape.last = SDL_calloc(area, sizeof(Cell));
+  tape.view = SDL_calloc(MODEL_CELLS(dimensions), sizeof(Cell));
+  tape.view_sequence = INDEX_NONE;
+  ASSERT(tape.entries);
+  ASSERT(tape.bytes);
+  ASSERT(tape.scratch);
+  ASSERT(tape.current);
+  ASSERT(tape.last);
+  ASSERT(tape.view);
+  return tape;
+}
+
+Void tape_free(Tape* tape)
+{
+  SDL_free(tape->entries);
+  SDL_free(tape->bytes);
+  SDL_free(tape->scratch);
+  SDL_free(tape->current);
+  SDL_free(tape->last);
+  SDL_free(tape->view);
+  *tape = (Tape) {0};
+}
+
+Void tape_clear(Tape* tape)
+{
+  tape->first = tape->count;
+  tape->write = 0;
+  tape->view_sequence = INDEX_NONE;
+}
+
+Void tape_record(Tape* tape, const Model* m)
+{
+  ASSERT(v2s_equal(tape->dimensions, m->dimensions));
+  const V2S d = tape->dimensions;
+  const RegisterFile* const rf = m->register_file;
+
+  // slots are published every block, but beats are further apart
+  if (tape->first < tape->count) {
+    const Index newest = entry_at(tape, tape->count - 1)->frame;
+    if (rf->frame == newest) {
+      return;
+    } else if (rf->frame < newest) {
+      tape_clear(tape);
+    }
+  }
+
+  // gather the grid without its apron
+  Cell* const cells = tape->current;
+  for (S32 y = 0; y < d.y; y++) {
+    memcpy(&cells[y * d.x], &MODEL_INDEX(m, 0, y), d.x * sizeof(Cell));
+  }
+
+  Bool keyframe = tape->first == tape->count || tape->count % TAPE_KEYFRAME == 0;
+  Index length = encode(tape, cells, rf, keyframe, tape->scratch);
+  Index offset = claim(tape, length);
+  if (keyframe == false && tape->first == tape->count) {
+    // everything before it was dropped
+    keyframe = true;
+    length = encode(tape, cells, rf, keyframe, tape->scratch);
+    offset = claim(tape, length);
+  }
+
+  memcpy(&tape->bytes[offset], tape->scratch, length);
+  *entry_at(tape, tape->count) = (TapeEntry) {
+    .frame = rf->frame,
+    .offset = offset,
+    .length = length,
+    .keyframe = keyframe,
+  };
+  tape->count += 1;
+  tape->write = offset + length;
+  memcpy(tape->last, cells, d.x * d.y * sizeof(Cell));
+  tape->last_registers = *rf;
+  if (tape->view_sequence < tape->first) {
+    tape->view_sequence = INDEX_NONE;
+  }
+}
+
+Index tape_bytes(const Tape* tape)
+{
+  Index bytes = 0;
+  for (Index i = tape->first; i < tape->count; i++) {
+    bytes += entry_at(tape, i)->length;
+  }
+  return bytes;
+}
+
+Index tape_first_frame(const Tape* tape)
+{
+  return tape->first < tape->count ? entry_at(tape, tape->first)->frame : INDEX_NONE;
+}
+
+Index tape_last_frame(const Tape* tape)
+{
+  return tape->first < tape->count ? entry_at(tape, tape->count - 1)->frame : INDEX_NONE;
+}
+
+Bool tape_read(Tape* tape, Index frame, Model* out)
+{
+  if (tape->first == tape->count || frame < entry_at(tape, tape->first)->frame) {
+    return false;
+  }
+
+  // the newest entry at or before the frame
+  Index low = tape->first;
+  Index high = tape->count;
+  while (high - low > 1) {
+    const Index middle = low + (high - low) / 2;
+    if (entry_at(tape, middle)->frame <= frame) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  // decode from its keyframe, or from the beat last read if that is closer
+  Index start = low;
+  while (entry_at(tape, start)->keyframe == false) {
+    start -= 1;
+  }
+  const Index view = tape->view_sequence;
+  if (view != INDEX_NONE && view >= start && view <= low) {
+    start = view + 1;
+  }
+  for (Index i = start; i <= low; i++) {
+    decode(tape, entry_at(tape, i));
+  }
+  tape->view_sequence = low;
+
+  *out = (Model) {
+    .dimensions = tape->dimensions,
+    .register_file = &tape->view_registers,
+    .memory = tape->view,
+  };
+  return true;
+}
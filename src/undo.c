@@ -0,0 +1,143 @@
+#include <string.h>
+#include <SDL3/SDL_stdinc.h>
+#include "undo.h"
+
+// cells replaced and written by the recorded edits, filled by the audio thread
+static Cell undo_cells[UNDO_CELLS] = {0};
+
+// Steps in the order they were made, as a ring starting at the oldest. Those
+// before the cursor can be undone, and those from it on can be redone.
+static UndoStep undo_steps[UNDO_DEPTH] = {0};
+static Index undo_first = 0;
+static Index undo_count = 0;
+static Index undo_cursor = 0;
+
+static Index step_area(const UndoStep* step)
+{
+  return step->size.x * step->size.y;
+}
+
+static UndoStep* step_at(Index i)
+{
+  return &undo_steps[(undo_first + i) % UNDO_DEPTH];
+}
+
+static Void forget_oldest(Void)
+{
+  undo_first = (undo_first + 1) % UNDO_DEPTH;
+  undo_count -= 1;
+  undo_cursor -= 1;
+}
+
+Void undo_reset(Void)
+{
+  undo_first = 0;
+  undo_count = 0;
+  undo_cursor = 0;
+}
+
+Bool undo_record(V2S dimensions, V2S origin, V2S size, UndoStep* step)
+{
+  *step = (UndoStep) {0};
+
+  // a new edit forgets the steps undone before it
+  undo_count = undo_cursor;
+
+  const Index need = 2 * size.x * size.y;
+  if (need > UNDO_CELLS) {
+    undo_reset();
+    return false;
+  }
+
+  // Storage follows the steps around the ring, so the room after the newest
+  // step runs into the oldest.
+  Index start = 0;
+  if (undo_count > 0) {
+    const UndoStep* const newest = step_at(undo_count - 1);
+    start = newest->cells + 2 * step_area(newest);
+    if (start + need > UNDO_CELLS) {
+      start = 0;
+    }
+  }
+  while (undo_count > 0) {
+    const UndoStep* const oldest = step_at(0);
+    const Bool overlap = oldest->cells < start + need && start < oldest->cells + 2 * step_area(oldest);
+    if (overlap == false && undo_count < UNDO_DEPTH) {
+      break;
+    }
+    forget_oldest();
+  }
+
+  *step = (UndoStep) {
+    .dimensions = dimensions,
+    .origin = origin,
+    .size = size,
+    .cells = start,
+  };
+  *step_at(undo_count) = *step;
+  undo_count += 1;
+  undo_cursor = undo_count;
+  return true;
+}
+
+Bool undo_back(UndoStep* step)
+{
+  if (undo_cursor == 0) {
+    return false;
+  }
+  undo_cursor -= 1;
+  *step = *step_at(undo_cursor);
+  return true;
+}
+
+Bool undo_forward(UndoStep* step)
+{
+  if (undo_cursor == undo_count) {
+    return false;
+  }
+  *step = *step_at(undo_cursor);
+  undo_cursor += 1;
+  return true;
+}
+
+// copy the step's tiles into its storage, skipping those off the grid
+static Void gather(const Model* m, const UndoStep* step, Cell* out)
+{
+  for (S32 y = 0; y < step->size.y; y++) {
+    for (S32 x = 0; x < step->size.x; x++) {
+      const V2S point = { step->origin.x + x, step->origin.y + y };
+      if (valid_point(m->dimensions, point)) {
+        out[y * step->size.x + x] = MODEL_INDEX(m, point.x, point.y) & ~CELL_PULSE;
+      }
+    }
+  }
+}
+
+Void undo_before(const Model* m, const UndoStep* step)
+{
+  gather(m, step, &undo_cells[step->cells]);
+}
+
+Void undo_after(const Model* m, const UndoStep* step)
+{
+  gather(m, step, &undo_cells[step->cells + step_area(step)]);
+}
+
+Void undo_restore(Model* m, const UndoStep* step, Bool forward)
+{
+  // the grid was resized after the step was sent
+  if (v2s_equal(step->dimensions, m->dimensions) == false) {
+    return;
+  }
+
+  const Cell* const stored = &undo_cells[step->cells + (forward ? step_area(step) : 0)];
+  for (S32 y = 0; y < step->size.y; y++) {
+    for (S32 x = 0; x < step->size.x; x++) {
+      const V2S point = { step->origin.x + x, step->origin.y + y };
+      const Cell cell = stored[y * step->size.x + x];
+      if (valid_point(m->dimensions, point) && cell != (MODEL_INDEX(m, point.x, point.y) & ~CELL_PULSE)) {
+        model_set(m, point, value_of_cell(cell));
+      }
+    }
+  }
+}